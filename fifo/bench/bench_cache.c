@@ -0,0 +1,179 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: ring state cache miss benchmark, it counts the cache misses of the producers and the output
+ *           thread with perf_event_open. build it with -DFIFO_CACHE_LINE_SIZE=16 to pack the ring state
+ *           into one line and compare.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_MSG_SIZE              32
+#define BENCH_DEFAULT_THREADS       1
+#define BENCH_DEFAULT_MSGS          2000000
+#define BENCH_CAPACITY              (64 * 1024)
+
+/* counted events, the output thread is counted as a child of the main thread */
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} bench_events[] = {
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "l1d_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+};
+#define BENCH_EVENTS                (sizeof(bench_events) / sizeof(bench_events[0]))
+
+static pthread_barrier_t start_barrier;
+static fifo_t *bench_fifo;
+static size_t msgs_per_thread;
+
+static void discard_pop(const char *log, size_t size) {
+    (void)log;
+    (void)size;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * open a counter of the calling thread and the threads it creates later, the user space part only
+ *
+ * @return file descriptor, -1 when the event is not supported here, like in most virtual machines
+ */
+static int event_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void *producer(void *arg) {
+    char msg[BENCH_MSG_SIZE];
+    size_t i;
+
+    (void)arg;
+    memset(msg, 'c', sizeof(msg));
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < msgs_per_thread; i++) {
+        fifo_write_h(bench_fifo, msg, sizeof(msg));
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_THREADS;
+    FifoCfg cfg = { 0 };
+    pthread_t tid[threads > 0 ? threads : 1];
+    int fds[BENCH_EVENTS];
+    uint64_t begin, cost, value;
+    double total;
+    size_t i;
+    int t;
+
+    msgs_per_thread = argc > 2 ? strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_MSGS;
+    if (threads < 1) {
+        fprintf(stderr, "usage: %s [producer threads] [messages per thread]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* the counters are inherited by the output thread and the producers, so they are opened first */
+    for (i = 0; i < BENCH_EVENTS; i++) {
+        fds[i] = event_open(bench_events[i].type, bench_events[i].config);
+    }
+
+    cfg.callbacks.fp_fifo_pop = discard_pop;
+    cfg.capacity = BENCH_CAPACITY;
+    cfg.flags = threads == 1 ? FIFO_FLAG_SINGLE_PRODUCER : 0;
+    /* every message is output, so both sides move the indices the same number of times in every run */
+    cfg.overflow = FIFO_OVERFLOW_BLOCK;
+    bench_fifo = fifo_create(&cfg);
+    if (!bench_fifo) {
+        fprintf(stderr, "create failed\n");
+        return EXIT_FAILURE;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (t = 0; t < threads; t++) {
+        pthread_create(&tid[t], NULL, producer, NULL);
+    }
+    for (i = 0; i < BENCH_EVENTS; i++) {
+        if (fds[i] >= 0) {
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    begin = now_ns();
+    for (t = 0; t < threads; t++) {
+        pthread_join(tid[t], NULL);
+    }
+    /* the output thread exits after the remaining data, then its counts are added to this thread */
+    fifo_destroy(bench_fifo);
+    cost = now_ns() - begin;
+    pthread_barrier_destroy(&start_barrier);
+
+    total = (double)msgs_per_thread * threads;
+#ifdef FIFO_CACHE_LINE_SIZE
+    printf("\nstate_line,%d\n", FIFO_CACHE_LINE_SIZE);
+#else
+    printf("\nstate_line,default\n");
+#endif
+    printf("threads,pushes,ns_per_push\n%d,%.0f,%.1f\n", threads, total, cost / total);
+    printf("event,total,per_push\n");
+    for (i = 0; i < BENCH_EVENTS; i++) {
+        if (fds[i] < 0 || read(fds[i], &value, sizeof(value)) != sizeof(value)) {
+            printf("%s,n/a,n/a\n", bench_events[i].name);
+        } else {
+            printf("%s,%llu,%.3f\n", bench_events[i].name, (unsigned long long)value, value / total);
+        }
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
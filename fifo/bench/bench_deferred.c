@@ -0,0 +1,97 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2017, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: caller side cost of the deferred formatting against vsnprintf on the caller thread.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_MSGS          1000000
+/* large enough that the pushes are not dropped while the output thread keeps up */
+#define BENCH_CAPACITY              (64 * 1024 * 1024)
+
+static size_t msgs;
+
+static void discard_pop(const char *log, size_t size) {
+    (void)log;
+    (void)size;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * print one CSV row, only the stored pushes are counted
+ */
+static void bench_report(const char *mode, const char *format, uint64_t cost, size_t stored) {
+    printf("%s,\"%s\",%zu,%zu,%.1f\n", mode, format, msgs, msgs - stored, (double)cost / msgs);
+}
+
+/* every case pushes the same log with both paths */
+#define BENCH_CASE(format, ...)                                                             \
+    do {                                                                                    \
+        size_t i, stored;                                                                   \
+        uint64_t begin;                                                                     \
+        for (stored = 0, i = 0, begin = now_ns(); i < msgs; i++) {                          \
+            stored += fifo_push_h(fifo, format, __VA_ARGS__) == FIFO_NO_ERR;                \
+        }                                                                                   \
+        bench_report("vsnprintf", format, now_ns() - begin, stored);                        \
+        for (stored = 0, i = 0, begin = now_ns(); i < msgs; i++) {                          \
+            stored += fifo_dpush_h(fifo, format, __VA_ARGS__) == FIFO_NO_ERR;               \
+        }                                                                                   \
+        bench_report("deferred", format, now_ns() - begin, stored);                         \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    FifoCfg cfg = { 0 };
+    fifo_t *fifo;
+
+    msgs = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_MSGS;
+
+    cfg.callbacks.fp_fifo_pop = discard_pop;
+    cfg.flags = FIFO_FLAG_FRAMED;
+    cfg.capacity = BENCH_CAPACITY;
+    fifo = fifo_create(&cfg);
+    if (!fifo) {
+        printf("create fifo failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("\nmode,format,pushes,dropped,ns_per_push\n");
+    BENCH_CASE("request %d done", 42);
+    BENCH_CASE("order %lu price %.4f qty %d side %c", 123456789UL, 101.2575, 300, 'B');
+    BENCH_CASE("user %s from %s:%u took %.3f ms", "alice", "10.0.0.1", 8080u, 12.75);
+    BENCH_CASE("%d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8);
+
+    fifo_destroy(fifo);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: compression benchmark, ratio and throughput of the LZ codec on log text for several block sizes,
+ *           and the output thread drain rate with and without the compression sink.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <fifo_lz.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_TEXT_SIZE             (16 * 1024 * 1024)
+#define BENCH_DEFAULT_MSGS          1000000
+#define BENCH_CAPACITY              (64 * 1024 * 1024)
+/* partial block hold time of the compression sink, the idle wakeups would write tiny blocks without it */
+#define BENCH_HOLD_MS               20
+
+static const char *const bench_levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+static const char *const bench_users[] = { "alice", "bob", "carol", "dave", "erin" };
+
+/* sink at the end of the pipeline, it only counts */
+typedef struct {
+    FifoSink sink;
+    uint64_t bytes;
+} CountSink;
+
+static void count_write(FifoSink *sink, fifo_t *fifo, const struct iovec *iov, int iovcnt, size_t release,
+        bool in_ring) {
+    int i;
+
+    (void)in_ring;
+    for (i = 0; i < iovcnt; i++) {
+        ((CountSink *)sink)->bytes += iov[i].iov_len;
+    }
+    if (release) {
+        fifo_release_h(fifo, release);
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * one log line like a service writes, the fields repeat with some variation
+ */
+static int bench_line(char *buf, size_t size, size_t i) {
+    return snprintf(buf, size, "2026-10-17 12:%02zu:%02zu.%06zu [%s] user %s request %zu took %zu us status %d\n",
+            i / 60000 % 60, i / 1000 % 60, i * 37 % 1000000, bench_levels[i % 7 % 4], bench_users[i % 5],
+            i * 2654435761u % 100000, i * 131 % 5000, i % 13 ? 200 : 500);
+}
+
+/**
+ * compress and decompress the text in blocks, print one CSV row
+ */
+static int bench_codec(const char *text, size_t size, size_t block_size) {
+    char *out = malloc(FIFO_LZ_BOUND(block_size)), *back = malloc(block_size);
+    void *work = malloc(FIFO_LZ_WORK_SIZE);
+    size_t offset, block, packed = 0, result;
+    uint64_t begin, comp_ns, decomp_ns = 0;
+    int err = 0;
+
+    if (!out || !back || !work) {
+        free(out);
+        free(back);
+        free(work);
+        return -1;
+    }
+    begin = now_ns();
+    for (offset = 0; offset < size; offset += block) {
+        block = size - offset < block_size ? size - offset : block_size;
+        packed += fifo_lz_compress(text + offset, block, out, FIFO_LZ_BOUND(block_size), work);
+    }
+    comp_ns = now_ns() - begin;
+    for (offset = 0; offset < size; offset += block) {
+        block = size - offset < block_size ? size - offset : block_size;
+        result = fifo_lz_compress(text + offset, block, out, FIFO_LZ_BOUND(block_size), work);
+        begin = now_ns();
+        result = fifo_lz_decompress(out, result, back, block_size);
+        decomp_ns += now_ns() - begin;
+        if (result != block || memcmp(back, text + offset, block)) {
+            err = -1;
+        }
+    }
+    printf("codec,%zu,%.2f,%.1f,%.1f\n", block_size, (double)size / packed, size * 1e3 / comp_ns,
+            size * 1e3 / decomp_ns);
+    free(out);
+    free(back);
+    free(work);
+
+    return err;
+}
+
+/**
+ * push the lines and wait for the output thread to drain them, print one CSV row
+ */
+static int bench_pipeline(const char *mode, size_t msgs, bool compress) {
+    FifoCfg cfg = { 0 };
+    FifoLzSinkCfg lz_cfg = { 0 };
+    FifoLzSinkStats stats = { 0 };
+    CountSink count = { { count_write, NULL }, 0 };
+    FifoSink *lz = NULL;
+    fifo_t *fifo;
+    char line[256];
+    size_t i, raw = 0;
+    uint64_t begin, push_ns;
+    int size;
+
+    if (compress) {
+        lz_cfg.next = &count.sink;
+        lz_cfg.hold_ms = BENCH_HOLD_MS;
+        lz = fifo_lz_sink_create(&lz_cfg);
+        if (!lz) {
+            return -1;
+        }
+    }
+    cfg.flags = FIFO_FLAG_FRAMED;
+    cfg.capacity = BENCH_CAPACITY;
+    cfg.overflow = FIFO_OVERFLOW_BLOCK;
+    cfg.sink = compress ? lz : &count.sink;
+    fifo = fifo_create(&cfg);
+    if (!fifo) {
+        fifo_lz_sink_destroy(lz);
+        return -1;
+    }
+
+    begin = now_ns();
+    for (i = 0; i < msgs; i++) {
+        size = bench_line(line, sizeof(line), i);
+        fifo_write_h(fifo, line, size);
+        raw += size;
+    }
+    push_ns = now_ns() - begin;
+    /* the output thread drains the rest before it exits */
+    fifo_destroy(fifo);
+
+    if (lz) {
+        fifo_lz_sink_get_stats(lz, &stats);
+        fifo_lz_sink_destroy(lz);
+    }
+    printf("pipeline,%s,%zu,%.1f,%.1f,%llu,%.2f\n", mode, msgs, (double)push_ns / msgs,
+            raw * 1e3 / (now_ns() - begin), (unsigned long long)count.bytes, (double)raw / count.bytes);
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t block_sizes[] = { 4096, 16384, 65536, 262144 };
+    size_t msgs, size, i;
+    char *text;
+    int err = 0;
+
+    msgs = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_MSGS;
+
+    text = malloc(BENCH_TEXT_SIZE);
+    if (!text) {
+        return EXIT_FAILURE;
+    }
+    for (size = 0, i = 0; size + 256 < BENCH_TEXT_SIZE; i++) {
+        size += bench_line(text + size, BENCH_TEXT_SIZE - size, i);
+    }
+
+    printf("\nstage,block_size,ratio,compress_mb_s,decompress_mb_s\n");
+    for (i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+        err |= bench_codec(text, size, block_sizes[i]);
+    }
+    free(text);
+
+    printf("\nstage,mode,pushes,ns_per_push,drain_mb_s,output_bytes,ratio\n");
+    err |= bench_pipeline("raw", msgs, false);
+    err |= bench_pipeline("lz", msgs, true);
+
+    if (err) {
+        printf("round trip failed\n");
+    }
+
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
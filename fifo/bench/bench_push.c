@@ -0,0 +1,190 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2017, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: push throughput benchmark, lock free ring against the mutex ring.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define BENCH_MSG_SIZE              64
+#define BENCH_DEFAULT_THREADS       8
+#define BENCH_DEFAULT_MSGS          200000
+
+/* the mutex ring, it is the output path before the lock free ring */
+static pthread_mutex_t mutex_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t mutex_ring_sem;
+static char mutex_ring_buf[OUTPUT_BUF_SIZE];
+static size_t mutex_ring_write, mutex_ring_read, mutex_ring_used;
+static volatile bool mutex_ring_running;
+
+static pthread_barrier_t start_barrier;
+static size_t msgs_per_thread;
+
+static void discard_pop(const char *log, size_t size) {
+    (void)log;
+    (void)size;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void mutex_ring_push(const char *log, size_t size) {
+    size_t space, first;
+
+    pthread_mutex_lock(&mutex_ring_lock);
+    space = OUTPUT_BUF_SIZE - mutex_ring_used;
+    if (space < size) {
+        size = space;
+    }
+    if (size) {
+        first = OUTPUT_BUF_SIZE - mutex_ring_write;
+        if (first >= size) {
+            memcpy(mutex_ring_buf + mutex_ring_write, log, size);
+        } else {
+            memcpy(mutex_ring_buf + mutex_ring_write, log, first);
+            memcpy(mutex_ring_buf, log + first, size - first);
+        }
+        mutex_ring_write = (mutex_ring_write + size) % OUTPUT_BUF_SIZE;
+        mutex_ring_used += size;
+        sem_post(&mutex_ring_sem);
+    }
+    pthread_mutex_unlock(&mutex_ring_lock);
+}
+
+static void *mutex_ring_consumer(void *arg) {
+    static char out[OUTPUT_BUF_SIZE];
+    size_t size, first;
+
+    (void)arg;
+    while (mutex_ring_running) {
+        sem_wait(&mutex_ring_sem);
+        pthread_mutex_lock(&mutex_ring_lock);
+        size = mutex_ring_used;
+        first = OUTPUT_BUF_SIZE - mutex_ring_read;
+        if (first >= size) {
+            memcpy(out, mutex_ring_buf + mutex_ring_read, size);
+        } else {
+            memcpy(out, mutex_ring_buf + mutex_ring_read, first);
+            memcpy(out + first, mutex_ring_buf, size - first);
+        }
+        mutex_ring_read = (mutex_ring_read + size) % OUTPUT_BUF_SIZE;
+        mutex_ring_used = 0;
+        pthread_mutex_unlock(&mutex_ring_lock);
+        discard_pop(out, size);
+    }
+    return NULL;
+}
+
+static void *lock_free_producer(void *arg) {
+    char msg[BENCH_MSG_SIZE];
+    size_t i;
+
+    (void)arg;
+    memset(msg, 'f', sizeof(msg));
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < msgs_per_thread; i++) {
+        fifo_write(msg, sizeof(msg));
+    }
+    return NULL;
+}
+
+static void *mutex_producer(void *arg) {
+    char msg[BENCH_MSG_SIZE];
+    size_t i;
+
+    (void)arg;
+    memset(msg, 'm', sizeof(msg));
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < msgs_per_thread; i++) {
+        mutex_ring_push(msg, sizeof(msg));
+    }
+    return NULL;
+}
+
+/**
+ * run the producers and print one CSV row
+ */
+static void bench_run(const char *name, void *(*producer)(void *), int threads) {
+    pthread_t tid[threads];
+    uint64_t begin, cost;
+    double total;
+    int i;
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (i = 0; i < threads; i++) {
+        pthread_create(&tid[i], NULL, producer, NULL);
+    }
+    pthread_barrier_wait(&start_barrier);
+    begin = now_ns();
+    for (i = 0; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+    }
+    cost = now_ns() - begin;
+    pthread_barrier_destroy(&start_barrier);
+
+    total = (double)msgs_per_thread * threads;
+    printf("%s,%d,%.0f,%.1f,%.3f\n", name, threads, total, cost / total, total * 1000.0 / cost);
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_THREADS;
+    pthread_t consumer;
+    FifoCallbacks cb = { .fp_fifo_pop = discard_pop };
+    int threads;
+
+    msgs_per_thread = argc > 2 ? strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_MSGS;
+
+    fifo_init(&cb);
+    fifo_start();
+    printf("\nmode,threads,pushes,ns_per_push,mpush_per_s\n");
+    for (threads = 1; threads <= max_threads; threads++) {
+        bench_run("lock_free", lock_free_producer, threads);
+    }
+    fifo_stop();
+    fifo_deinit();
+    printf("\n");
+
+    sem_init(&mutex_ring_sem, 0, 0);
+    mutex_ring_running = true;
+    pthread_create(&consumer, NULL, mutex_ring_consumer, NULL);
+    for (threads = 1; threads <= max_threads; threads++) {
+        bench_run("mutex", mutex_producer, threads);
+    }
+    mutex_ring_running = false;
+    sem_post(&mutex_ring_sem);
+    pthread_join(consumer, NULL);
+    sem_destroy(&mutex_ring_sem);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: benchmark suite. It measures the push latency percentiles, the throughput and the end to end
+ *           latency over the producer count, message size, ring size and consumer speed, the results are
+ *           CSV rows or JSON lines.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_PRODUCERS     4
+#define BENCH_DEFAULT_MSGS          50000
+#define BENCH_MSG_SIZE_MAX          1024
+/* output time of every record with the slow consumer */
+#define BENCH_SLOW_CONSUMER_NS      1000
+
+static const size_t bench_msg_sizes[] = { 16, 64, 256, BENCH_MSG_SIZE_MAX };
+static const size_t bench_ring_sizes[] = { 64 * 1024, 1024 * 1024 };
+
+/* one benchmark case */
+typedef struct {
+    int producers;
+    size_t msg_size;
+    size_t ring_size;
+    bool slow;
+} BenchCase;
+
+/* producer thread state */
+typedef struct {
+    fifo_t *fifo;
+    size_t msg_size;
+    /* push time of every push */
+    uint32_t *push_ns;
+    /* pushes which are not dropped */
+    size_t accepted;
+    /* push loop start and end, the threads do not wait for the main thread to be scheduled */
+    uint64_t begin;
+    uint64_t end;
+} BenchProducer;
+
+static pthread_barrier_t start_barrier;
+static size_t msgs_per_thread;
+static bool slow_consumer;
+/* end to end latency of every output record, only the output thread writes them */
+static uint32_t *e2e_ns;
+static size_t e2e_count, e2e_cap;
+/* output records and the time the last one is output, only the output thread writes them */
+static size_t delivered;
+static uint64_t delivered_end;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t clamp_ns(uint64_t ns) {
+    return ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+static int cmp_ns(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * percentile of the sorted samples
+ */
+static uint32_t percentile(const uint32_t *sorted, size_t count, double p) {
+    return count ? sorted[(size_t)(p * (count - 1))] : 0;
+}
+
+/**
+ * the record timestamps are taken on the same monotonic clock at the push
+ */
+static void bench_pop_records(const FifoRecord *records, size_t count) {
+    uint64_t now = now_ns();
+    size_t i;
+
+    for (i = 0; i < count && e2e_count < e2e_cap; i++) {
+        e2e_ns[e2e_count++] = clamp_ns(now > records[i].timestamp ? now - records[i].timestamp : 0);
+    }
+    if (slow_consumer) {
+        while (now_ns() - now < count * BENCH_SLOW_CONSUMER_NS);
+    }
+    delivered += count;
+    delivered_end = now_ns();
+}
+
+static void *bench_producer(void *arg) {
+    BenchProducer *producer = arg;
+    char msg[BENCH_MSG_SIZE_MAX];
+    uint64_t begin;
+    FifoErrCode result;
+    size_t i;
+
+    memset(msg, 'b', sizeof(msg));
+    pthread_barrier_wait(&start_barrier);
+    producer->begin = now_ns();
+    for (i = 0; i < msgs_per_thread; i++) {
+        begin = now_ns();
+        result = fifo_write_h(producer->fifo, msg, producer->msg_size);
+        producer->push_ns[i] = clamp_ns(now_ns() - begin);
+        if (result == FIFO_NO_ERR) {
+            producer->accepted++;
+        }
+    }
+    producer->end = now_ns();
+    return NULL;
+}
+
+/**
+ * run one case and print its result, the ring buffer drops the pushes it has no space for.
+ * the accepted throughput ends with the last push, the delivered one with the output of the last record
+ *
+ * @return false when no memory
+ */
+static bool bench_run(const BenchCase *bench, bool json) {
+    FifoCfg cfg = { 0 };
+    BenchProducer producers[bench->producers];
+    pthread_t tid[bench->producers];
+    size_t total = msgs_per_thread * bench->producers, accepted = 0;
+    uint32_t *push_ns;
+    uint64_t begin = UINT64_MAX, end = 0, cost, output_cost;
+    double accepted_msgs_per_s, accepted_gb_per_s, delivered_msgs_per_s, delivered_gb_per_s;
+    fifo_t *fifo;
+    int p;
+
+    push_ns = malloc(total * sizeof(uint32_t));
+    e2e_ns = malloc(total * sizeof(uint32_t));
+    if (!push_ns || !e2e_ns) {
+        free(push_ns);
+        free(e2e_ns);
+        return false;
+    }
+    e2e_count = 0;
+    e2e_cap = total;
+    delivered = 0;
+    delivered_end = 0;
+    slow_consumer = bench->slow;
+
+    cfg.callbacks.fp_fifo_pop_records = bench_pop_records;
+    cfg.capacity = bench->ring_size;
+    cfg.flags = FIFO_FLAG_FRAMED | FIFO_FLAG_TIMESTAMP | (bench->producers == 1 ? FIFO_FLAG_SINGLE_PRODUCER : 0);
+    cfg.overflow = FIFO_OVERFLOW_DROP;
+    fifo = fifo_create(&cfg);
+    if (!fifo) {
+        free(push_ns);
+        free(e2e_ns);
+        return false;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, bench->producers + 1);
+    for (p = 0; p < bench->producers; p++) {
+        producers[p].fifo = fifo;
+        producers[p].msg_size = bench->msg_size;
+        producers[p].push_ns = push_ns + p * msgs_per_thread;
+        producers[p].accepted = 0;
+        pthread_create(&tid[p], NULL, bench_producer, &producers[p]);
+    }
+    pthread_barrier_wait(&start_barrier);
+    for (p = 0; p < bench->producers; p++) {
+        pthread_join(tid[p], NULL);
+        accepted += producers[p].accepted;
+        begin = producers[p].begin < begin ? producers[p].begin : begin;
+        end = producers[p].end > end ? producers[p].end : end;
+    }
+    cost = end - begin;
+    pthread_barrier_destroy(&start_barrier);
+    /* the output thread outputs the remaining records before it exits */
+    fifo_destroy(fifo);
+    output_cost = delivered_end > begin ? delivered_end - begin : 0;
+
+    qsort(push_ns, total, sizeof(uint32_t), cmp_ns);
+    qsort(e2e_ns, e2e_count, sizeof(uint32_t), cmp_ns);
+    accepted_msgs_per_s = cost ? accepted * 1e9 / cost : 0;
+    accepted_gb_per_s = cost ? (double)accepted * bench->msg_size / cost : 0;
+    delivered_msgs_per_s = output_cost ? delivered * 1e9 / output_cost : 0;
+    delivered_gb_per_s = output_cost ? (double)delivered * bench->msg_size / output_cost : 0;
+
+    printf(json ? "{\"producers\":%d,\"msg_size\":%zu,\"ring_size\":%zu,\"consumer\":\"%s\",\"pushes\":%zu,"
+            "\"dropped\":%zu,\"push_p50_ns\":%u,\"push_p99_ns\":%u,\"push_p999_ns\":%u,"
+            "\"accepted_msgs_per_s\":%.0f,\"accepted_gb_per_s\":%.3f,\"delivered_msgs_per_s\":%.0f,"
+            "\"delivered_gb_per_s\":%.3f,\"e2e_p50_ns\":%u,\"e2e_p99_ns\":%u,\"e2e_p999_ns\":%u}\n"
+            : "%d,%zu,%zu,%s,%zu,%zu,%u,%u,%u,%.0f,%.3f,%.0f,%.3f,%u,%u,%u\n",
+            bench->producers, bench->msg_size, bench->ring_size, bench->slow ? "slow" : "fast", total,
+            total - accepted, percentile(push_ns, total, 0.5), percentile(push_ns, total, 0.99),
+            percentile(push_ns, total, 0.999), accepted_msgs_per_s, accepted_gb_per_s, delivered_msgs_per_s,
+            delivered_gb_per_s, percentile(e2e_ns, e2e_count, 0.5), percentile(e2e_ns, e2e_count, 0.99),
+            percentile(e2e_ns, e2e_count, 0.999));
+    fflush(stdout);
+
+    free(push_ns);
+    free(e2e_ns);
+    e2e_ns = NULL;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int max_producers = BENCH_DEFAULT_PRODUCERS, opt, slow;
+    bool json = false;
+    BenchCase bench;
+    size_t s, r;
+
+    msgs_per_thread = BENCH_DEFAULT_MSGS;
+    while ((opt = getopt(argc, argv, "p:n:j")) != -1) {
+        switch (opt) {
+        case 'p':
+            max_producers = atoi(optarg);
+            break;
+        case 'n':
+            msgs_per_thread = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            max_producers = 0;
+            break;
+        }
+    }
+    if (max_producers < 1 || !msgs_per_thread) {
+        fprintf(stderr, "usage: %s [-p max producers] [-n messages per producer] [-j]\n"
+                "  the producer count doubles from 1 to the max, -j prints JSON lines instead of CSV\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!json) {
+        printf("producers,msg_size,ring_size,consumer,pushes,dropped,push_p50_ns,push_p99_ns,push_p999_ns,"
+                "accepted_msgs_per_s,accepted_gb_per_s,delivered_msgs_per_s,delivered_gb_per_s,"
+                "e2e_p50_ns,e2e_p99_ns,e2e_p999_ns\n");
+    }
+    for (bench.producers = 1; bench.producers <= max_producers; bench.producers *= 2) {
+        for (s = 0; s < sizeof(bench_msg_sizes) / sizeof(bench_msg_sizes[0]); s++) {
+            for (r = 0; r < sizeof(bench_ring_sizes) / sizeof(bench_ring_sizes[0]); r++) {
+                for (slow = 0; slow <= 1; slow++) {
+                    bench.msg_size = bench_msg_sizes[s];
+                    bench.ring_size = bench_ring_sizes[r];
+                    bench.slow = slow;
+                    if (!bench_run(&bench, json)) {
+                        fprintf(stderr, "no memory for %d producers\n", bench.producers);
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
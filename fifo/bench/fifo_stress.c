@@ -0,0 +1,322 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: stress harness. Producers push messages of random size with a checkable payload into small
+ *           ring buffers, so the indices wrap around all the time. The output thread checks that every
+ *           message of a producer arrives once, in order and byte exact.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define STRESS_MAGIC                0x53545253
+#define STRESS_DEFAULT_PRODUCERS    4
+#define STRESS_PRODUCERS_MAX        64
+#define STRESS_DEFAULT_MSGS         100000
+#define STRESS_MSG_SIZE_MAX         8192
+/* reported errors of a case, the rest are only counted */
+#define STRESS_ERRORS_PRINT         5
+
+/* message header, the payload follows it */
+typedef struct {
+    uint32_t magic;
+    uint16_t producer;
+    /* message size with the header */
+    uint16_t size;
+    uint32_t seq;
+} StressHdr;
+
+/* one stress case */
+typedef struct {
+    const char *name;
+    uint32_t flags;
+    size_t capacity;
+    /* push with fifo_reserve_h and fifo_commit_h instead of fifo_write_h */
+    bool reserve;
+} StressCase;
+
+static const StressCase stress_cases[] = {
+    { "stream_mp",          0,                                                          4096,   false },
+    { "stream_sp",          FIFO_FLAG_SINGLE_PRODUCER,                                  4096,   false },
+    { "stream_reserve_mp",  0,                                                          4096,   true },
+    { "framed_mp",          FIFO_FLAG_FRAMED,                                           4096,   false },
+    { "framed_sp",          FIFO_FLAG_FRAMED | FIFO_FLAG_SINGLE_PRODUCER,               4096,   false },
+    { "framed_reserve_mp",  FIFO_FLAG_FRAMED,                                           4096,   true },
+    { "framed_seq_mp",      FIFO_FLAG_FRAMED | FIFO_FLAG_SEQ | FIFO_FLAG_TIMESTAMP,     65536,  false },
+};
+
+static const StressCase *stress_case;
+static fifo_t *stress_fifo;
+static int stress_producers;
+static size_t msgs_per_thread, max_msg_size;
+/* checker state, only the output thread writes it */
+static uint32_t expect_seq[STRESS_PRODUCERS_MAX];
+static uint64_t expect_rec_seq;
+static size_t checked, errors;
+static char stream_msg[STRESS_MSG_SIZE_MAX];
+static size_t stream_have;
+static bool stream_lost;
+
+static void stress_error(const char *format, ...) {
+    va_list args;
+
+    if (errors++ < STRESS_ERRORS_PRINT) {
+        va_start(args, format);
+        printf("  %s: ", stress_case->name);
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+    }
+}
+
+static uint32_t stress_hash(uint32_t producer, uint32_t seq) {
+    uint32_t h = seq * 2654435761u ^ (producer + 1) * 40503u;
+
+    h ^= h >> 15;
+    h *= 2246822519u;
+    return h ^ (h >> 13);
+}
+
+static uint8_t stress_byte(uint32_t hash, size_t k) {
+    return (uint8_t)((hash >> (k % 4 * 8)) + k);
+}
+
+/**
+ * build the message of a producer sequence number
+ *
+ * @return message size
+ */
+static size_t stress_fill(char *msg, uint32_t producer, uint32_t seq) {
+    uint32_t hash = stress_hash(producer, seq);
+    StressHdr hdr = { STRESS_MAGIC, (uint16_t)producer, 0, seq };
+    size_t k, payload = hash % (max_msg_size - sizeof(StressHdr) + 1);
+
+    hdr.size = (uint16_t)(sizeof(StressHdr) + payload);
+    memcpy(msg, &hdr, sizeof(hdr));
+    for (k = 0; k < payload; k++) {
+        msg[sizeof(hdr) + k] = (char)stress_byte(hash, k);
+    }
+    return hdr.size;
+}
+
+static void stress_check(const char *msg, size_t size) {
+    StressHdr hdr;
+    uint32_t hash;
+    size_t k;
+
+    if (size < sizeof(hdr)) {
+        stress_error("short message of %zu bytes", size);
+        return;
+    }
+    memcpy(&hdr, msg, sizeof(hdr));
+    if (hdr.magic != STRESS_MAGIC || hdr.producer >= stress_producers || hdr.size != size) {
+        stress_error("corrupted header, producer %u size %u of %zu", hdr.producer, hdr.size, size);
+        return;
+    }
+    if (hdr.seq != expect_seq[hdr.producer]) {
+        stress_error("producer %u message %u, expected %u", hdr.producer, hdr.seq, expect_seq[hdr.producer]);
+    }
+    expect_seq[hdr.producer] = hdr.seq + 1;
+    hash = stress_hash(hdr.producer, hdr.seq);
+    for (k = 0; k < size - sizeof(hdr); k++) {
+        if ((uint8_t)msg[sizeof(hdr) + k] != stress_byte(hash, k)) {
+            stress_error("producer %u message %u corrupted at byte %zu", hdr.producer, hdr.seq, k);
+            break;
+        }
+    }
+    checked++;
+}
+
+/**
+ * size of the message being reassembled from the stream
+ */
+static size_t stream_need(void) {
+    StressHdr hdr;
+
+    if (stream_have < sizeof(hdr)) {
+        return sizeof(hdr);
+    }
+    memcpy(&hdr, stream_msg, sizeof(hdr));
+    return hdr.size;
+}
+
+/**
+ * stream mode output, the messages are cut anywhere by the batches
+ */
+static void stress_pop(const char *log, size_t size) {
+    size_t need, n;
+
+    while (size && !stream_lost) {
+        need = stream_need();
+        if (need < sizeof(StressHdr) || need > max_msg_size) {
+            /* the message boundary is lost, the rest of the stream can not be checked */
+            stress_error("corrupted stream, message size %zu", need);
+            stream_lost = true;
+            return;
+        }
+        n = need - stream_have < size ? need - stream_have : size;
+        memcpy(stream_msg + stream_have, log, n);
+        stream_have += n;
+        log += n;
+        size -= n;
+        if (stream_have >= sizeof(StressHdr) && stream_have == stream_need()) {
+            stress_check(stream_msg, stream_have);
+            stream_have = 0;
+        }
+    }
+}
+
+static void stress_pop_records(const FifoRecord *records, size_t count) {
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (stress_case->flags & FIFO_FLAG_SEQ) {
+            if (records[i].seq != expect_rec_seq) {
+                stress_error("record sequence number %llu, expected %llu", (unsigned long long)records[i].seq,
+                        (unsigned long long)expect_rec_seq);
+            }
+            expect_rec_seq = records[i].seq + 1;
+        }
+        stress_check(records[i].data, records[i].size);
+    }
+}
+
+static void *stress_producer(void *arg) {
+    uint32_t producer = (uint32_t)(uintptr_t)arg, seq;
+    char msg[STRESS_MSG_SIZE_MAX];
+    size_t size;
+    void *ptr;
+
+    for (seq = 0; seq < msgs_per_thread; seq++) {
+        size = stress_fill(msg, producer, seq);
+        if (stress_case->reserve) {
+            while (!(ptr = fifo_reserve_h(stress_fifo, size))) {
+                sched_yield();
+            }
+            memcpy(ptr, msg, size);
+            fifo_commit_h(stress_fifo, size);
+        } else {
+            while (fifo_write_h(stress_fifo, msg, size) != FIFO_NO_ERR) {
+                sched_yield();
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * run one case, the ring buffer blocks the producers when it is full so nothing is dropped
+ *
+ * @return errors of the case
+ */
+static size_t stress_run(const StressCase *c) {
+    FifoCfg cfg = { 0 };
+    pthread_t tid[STRESS_PRODUCERS_MAX];
+    int producers = (c->flags & FIFO_FLAG_SINGLE_PRODUCER) ? 1 : stress_producers, p;
+
+    stress_case = c;
+    memset(expect_seq, 0, sizeof(expect_seq));
+    expect_rec_seq = 0;
+    checked = errors = 0;
+    stream_have = 0;
+    stream_lost = false;
+    /* the messages are up to an eighth of the ring buffer */
+    max_msg_size = c->capacity / 8 < STRESS_MSG_SIZE_MAX ? c->capacity / 8 : STRESS_MSG_SIZE_MAX;
+
+    if (c->flags & FIFO_FLAG_FRAMED) {
+        cfg.callbacks.fp_fifo_pop_records = stress_pop_records;
+    } else {
+        cfg.callbacks.fp_fifo_pop = stress_pop;
+    }
+    cfg.capacity = c->capacity;
+    cfg.flags = c->flags;
+    cfg.overflow = FIFO_OVERFLOW_BLOCK;
+    stress_fifo = fifo_create(&cfg);
+    if (!stress_fifo) {
+        printf("%s: create failed\n", c->name);
+        return 1;
+    }
+    for (p = 0; p < producers; p++) {
+        pthread_create(&tid[p], NULL, stress_producer, (void *)(uintptr_t)p);
+    }
+    for (p = 0; p < producers; p++) {
+        pthread_join(tid[p], NULL);
+    }
+    /* the output thread checks the remaining messages before it exits */
+    fifo_destroy(stress_fifo);
+
+    for (p = 0; p < producers; p++) {
+        if (expect_seq[p] != msgs_per_thread) {
+            stress_error("producer %d got %u of %zu messages", p, expect_seq[p], msgs_per_thread);
+        }
+    }
+    if (stream_have) {
+        stress_error("%zu bytes of a cut message left", stream_have);
+    }
+    printf("%s,%d,%zu,%zu,%zu,%s\n", c->name, producers, c->capacity, checked, errors, errors ? "FAIL" : "ok");
+    fflush(stdout);
+
+    return errors;
+}
+
+int main(int argc, char *argv[]) {
+    size_t i, failed = 0;
+    int opt;
+
+    stress_producers = STRESS_DEFAULT_PRODUCERS;
+    msgs_per_thread = STRESS_DEFAULT_MSGS;
+    while ((opt = getopt(argc, argv, "p:n:")) != -1) {
+        switch (opt) {
+        case 'p':
+            stress_producers = atoi(optarg);
+            break;
+        case 'n':
+            msgs_per_thread = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            stress_producers = 0;
+            break;
+        }
+    }
+    if (stress_producers < 1 || stress_producers > STRESS_PRODUCERS_MAX || !msgs_per_thread
+            || msgs_per_thread > UINT32_MAX) {
+        fprintf(stderr, "usage: %s [-p producers, up to %d] [-n messages per producer]\n", argv[0],
+                STRESS_PRODUCERS_MAX);
+        return EXIT_FAILURE;
+    }
+
+    printf("case,producers,capacity,messages,errors,result\n");
+    for (i = 0; i < sizeof(stress_cases) / sizeof(stress_cases[0]); i++) {
+        failed += stress_run(&stress_cases[i]) != 0;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
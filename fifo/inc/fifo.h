@@ -32,6 +32,15 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#else
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,26 +48,459 @@ extern "C" {
 
 /* fifo software version number */
 #define FIFO_SW_VERSION                      "2.2.99"
-/* buffer size for asynchronous output mode */
+/* default buffer size for asynchronous output mode, it must be power of 2 */
 #define OUTPUT_BUF_SIZE           (1024 * 8)
+/* enable it when only one thread pushes to the default fifo, producers will skip the atomic reservation */
+/* #define FIFO_SINGLE_PRODUCER */
+/* enable it to drain the default fifo with fifo_poll or from an event loop by fifo_get_fd, no output thread runs */
+/* #define FIFO_NO_THREAD */
+/* enable it to collect the statistics of every instance, a push reads the clock twice for the histogram */
+/* #define FIFO_USING_STATS */
+
+/* fifo create flags */
+#define FIFO_FLAG_SINGLE_PRODUCER            (1 << 0)
+/* back the ring buffer with huge pages when the platform supports it */
+#define FIFO_FLAG_HUGE_PAGE                  (1 << 1)
+/* prefault and lock the ring buffer in memory, so the producers never take a page fault */
+#define FIFO_FLAG_MLOCK                      (1 << 2)
+/* framed mode, every push is stored as a whole record and output as a whole record */
+#define FIFO_FLAG_FRAMED                     (1 << 3)
+/* framed mode records carry a sequence number */
+#define FIFO_FLAG_SEQ                        (1 << 4)
+/* framed mode records carry the push timestamp, a private ring buffer stamps the invariant TSC
+ * and converts it on the output thread */
+#define FIFO_FLAG_TIMESTAMP                  (1 << 5)
+/* attach to the shared memory ring buffer of a collector process as a producer, no output thread runs.
+ * the capacity and the record format come from the collector */
+#define FIFO_FLAG_SHM_PRODUCER               (1 << 6)
+/* no output thread runs, the owner drains the ring buffer with fifo_poll_h, or with fifo_peek_h and
+ * fifo_release_h when it has no callbacks */
+#define FIFO_FLAG_NO_THREAD                  (1 << 7)
+
+/* max records passed to fp_fifo_pop_records or fp_fifo_pop_iov at a time */
+#define FIFO_POP_RECORDS_MAX                 64
+/* max arguments of fifo_dpush */
+#define FIFO_DPUSH_ARGS_MAX                  12
+
+/* argument types of the deferred formatting, they follow the default argument promotions */
+typedef enum {
+    FIFO_ARG_INT,
+    FIFO_ARG_LONG,
+    FIFO_ARG_LLONG,
+    FIFO_ARG_DOUBLE,
+    FIFO_ARG_LDOUBLE,
+    /* the string is copied, so it can be freed after the push */
+    FIFO_ARG_STR,
+    FIFO_ARG_PTR,
+} FifoArgType;
+
+#ifndef __cplusplus
+#define FIFO_ARG_TYPE(x) _Generic((x),                                                  \
+        _Bool: FIFO_ARG_INT, char: FIFO_ARG_INT, signed char: FIFO_ARG_INT,                 \
+        unsigned char: FIFO_ARG_INT, short: FIFO_ARG_INT, unsigned short: FIFO_ARG_INT,     \
+        int: FIFO_ARG_INT, unsigned int: FIFO_ARG_INT,                                      \
+        long: FIFO_ARG_LONG, unsigned long: FIFO_ARG_LONG,                                  \
+        long long: FIFO_ARG_LLONG, unsigned long long: FIFO_ARG_LLONG,                      \
+        float: FIFO_ARG_DOUBLE, double: FIFO_ARG_DOUBLE, long double: FIFO_ARG_LDOUBLE,     \
+        char *: FIFO_ARG_STR, const char *: FIFO_ARG_STR,                                   \
+        default: FIFO_ARG_PTR)
+
+/* the arguments after the format are counted, the format keeps the comma elision working in ISO mode */
+#define FIFO_ARGS_COUNT(format, ...) FIFO_ARGS_COUNT_(format, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define FIFO_ARGS_COUNT_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define FIFO_ARGS_CAT(a, b) FIFO_ARGS_CAT_(a, b)
+#define FIFO_ARGS_CAT_(a, b) a##b
+#define FIFO_ARG_TYPES(format, ...) FIFO_ARGS_CAT(FIFO_ARG_TYPES_, FIFO_ARGS_COUNT(format, ##__VA_ARGS__))(__VA_ARGS__)
+#define FIFO_ARG_TYPES_0() FIFO_ARG_INT
+#define FIFO_ARG_TYPES_1(a) FIFO_ARG_TYPE(a)
+#define FIFO_ARG_TYPES_2(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_1(__VA_ARGS__)
+#define FIFO_ARG_TYPES_3(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_2(__VA_ARGS__)
+#define FIFO_ARG_TYPES_4(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_3(__VA_ARGS__)
+#define FIFO_ARG_TYPES_5(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_4(__VA_ARGS__)
+#define FIFO_ARG_TYPES_6(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_5(__VA_ARGS__)
+#define FIFO_ARG_TYPES_7(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_6(__VA_ARGS__)
+#define FIFO_ARG_TYPES_8(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_7(__VA_ARGS__)
+#define FIFO_ARG_TYPES_9(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_8(__VA_ARGS__)
+#define FIFO_ARG_TYPES_10(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_9(__VA_ARGS__)
+#define FIFO_ARG_TYPES_11(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_10(__VA_ARGS__)
+#define FIFO_ARG_TYPES_12(a, ...) FIFO_ARG_TYPE(a), FIFO_ARG_TYPES_11(__VA_ARGS__)
+
+/**
+ * deferred formatting push, the caller stores the format pointer and the raw arguments only,
+ * the output thread formats the record before the pop callbacks.
+ * @note it needs FIFO_FLAG_FRAMED, otherwise the log is formatted at once like fifo_push_h.
+ *       a file-backed or shared memory ring buffer is also formatted at once.
+ *       the format must stay valid until it is output, a string literal is expected.
+ *       the arguments are scalars, strings or pointers, FIFO_DPUSH_ARGS_MAX at most.
+ */
+#define fifo_dpush_h(fifo, format, ...)                                                     \
+        fifo_dpush_args_h(fifo, format, (const uint8_t[]){ FIFO_ARG_TYPES(format, ##__VA_ARGS__) }, \
+                FIFO_ARGS_COUNT(format, ##__VA_ARGS__), ##__VA_ARGS__)
+#define fifo_dpush(format, ...)                                                             \
+        fifo_dpush_args(format, (const uint8_t[]){ FIFO_ARG_TYPES(format, ##__VA_ARGS__) },       \
+                FIFO_ARGS_COUNT(format, ##__VA_ARGS__), ##__VA_ARGS__)
+#endif /* __cplusplus */
 
 /* fifo error code */
 typedef enum {
     FIFO_NO_ERR,
+    FIFO_ERR_NO_MEM,
+    /* output is disabled or there is no instance, nothing is stored */
+    FIFO_ERR_DISABLED,
+    /* the ring buffer is full, nothing is stored */
+    FIFO_ERR_DROPPED,
+    /* the ring buffer is full or the log is too long, only the head of it is stored */
+    FIFO_ERR_TRUNCATED,
+    /* no space until the FIFO_OVERFLOW_BLOCK timeout, nothing is stored */
+    FIFO_ERR_TIMEOUT,
+    /* stored, the oldest data is discarded for it by FIFO_OVERFLOW_OVERWRITE */
+    FIFO_ERR_OVERWRITTEN,
+    /* stored in the spill file by FIFO_OVERFLOW_SPILL, it is output after the ring buffer drains */
+    FIFO_ERR_SPILLED,
+    /* the configuration is not supported */
+    FIFO_ERR_INVALID,
+    /* the output thread can not be started with FifoCfg.thread, errno tells the reason */
+    FIFO_ERR_THREAD,
+    /* a later reservation follows, the unused stream space can not be given back. nothing is published */
+    FIFO_ERR_BUSY,
 } FifoErrCode;
 
+/* record of the framed mode */
+typedef struct {
+    const char *data;
+    size_t size;
+    /* sequence number, it is valid with FIFO_FLAG_SEQ */
+    uint64_t seq;
+    /* monotonic push time in nanoseconds, it is valid with FIFO_FLAG_TIMESTAMP.
+     * add fifo_get_wall_offset() for the wall clock time */
+    uint64_t timestamp;
+    /* stream offset of the record, the free running ring buffer index of its header. a reader of a file
+     * backed ring buffer can resume from it, 0 for a record replayed from the spill file */
+    uint64_t offset;
+} FifoRecord;
+
 typedef struct {
-    /* Callback to pop out fifo data, user should impliment this function */
+    /* Callback to pop out fifo data, user should impliment this function.
+     * the log points into the ring buffer, it is released after the callback returns.
+     * it is called once for every record in framed mode when fp_fifo_pop_records is NULL */
     void (*fp_fifo_pop)(const char *log, size_t size); 
+    /* Callback to pop out the whole records of the framed mode */
+    void (*fp_fifo_pop_records)(const FifoRecord *records, size_t count);
+    /* Callback to pop out a whole batch at a time, it takes precedence over the others.
+     * the batch is every readable region of the ring buffer, one or two iovecs in stream mode
+     * and up to FIFO_POP_RECORDS_MAX records in framed mode, so it suits a single writev */
+    void (*fp_fifo_pop_iov)(const struct iovec *iov, int iovcnt);
 } FifoCallbacks;
 
+/* notice of the output thread, the platform may not support every type */
+typedef enum {
+    /* counting semaphore */
+    FIFO_NOTIFY_SEM,
+    /* linux futex */
+    FIFO_NOTIFY_FUTEX,
+    /* linux eventfd, with FIFO_FLAG_NO_THREAD fifo_get_fd_h gives it to an event loop */
+    FIFO_NOTIFY_EVENTFD,
+} FifoNotifyType;
+
+/* what a push does when the ring buffer is full */
+typedef enum {
+    /* drop the data which does not fit, stream mode keeps the head of it, framed mode drops the whole record */
+    FIFO_OVERFLOW_DROP,
+    /* discard the oldest data to make space, the output thread copies the data out before the callbacks */
+    FIFO_OVERFLOW_OVERWRITE,
+    /* wait for space until the block timeout */
+    FIFO_OVERFLOW_BLOCK,
+    /* append to the spill file, the output thread replays it after the ring buffer drains */
+    FIFO_OVERFLOW_SPILL,
+} FifoOverflow;
+
+/* shards limit of an instance group */
+#define FIFO_GROUP_SHARDS_MAX                256
+
+/* output order of an instance group */
+typedef enum {
+    /* every shard is output by its own thread in parallel, the callbacks must be thread safe */
+    FIFO_ORDER_NONE,
+    /* the output thread of the first shard merges all shards by sequence number, so the records are output
+     * in commit order. it needs FIFO_FLAG_FRAMED, and FIFO_OVERFLOW_DROP or FIFO_OVERFLOW_BLOCK */
+    FIFO_ORDER_SEQ,
+    /* the output thread of the first shard merges all shards by timestamp, FIFO_FLAG_TIMESTAMP is added.
+     * a shard keeps its commit order, and a record still in its push when a newer one of another shard is
+     * merged follows it, so records pushed within a push time of each other may swap. it needs the same
+     * configuration as FIFO_ORDER_SEQ, but the producers share no counter */
+    FIFO_ORDER_TIME,
+} FifoOrder;
+
+/* shard choice of fifo_group_shard */
+typedef enum {
+    /* every producer thread keeps a shard */
+    FIFO_SHARD_THREAD,
+    /* the shard of the CPU the producer runs on, the storage of a shard is on the NUMA node of its CPU.
+     * a thread moved to another CPU during a push still pushes to the former one, it is safe and rare */
+    FIFO_SHARD_CPU,
+} FifoShardBy;
+
+#ifdef FIFO_USING_STATS
+/* log-linear histogram, every power of 2 is split into 2^FIFO_HIST_SUB_BITS buckets */
+#define FIFO_HIST_SUB_BITS                   3
+/* values from 2^FIFO_HIST_MAX_BITS nanoseconds (about 18 minutes) are counted in the last bucket */
+#define FIFO_HIST_MAX_BITS                   40
+#define FIFO_HIST_BUCKETS                    ((FIFO_HIST_MAX_BITS - FIFO_HIST_SUB_BITS + 1) << FIFO_HIST_SUB_BITS)
+
+/* latency histogram in nanoseconds */
+typedef struct {
+    uint64_t count;
+    uint64_t buckets[FIFO_HIST_BUCKETS];
+} FifoHist;
+
+/* statistics of an instance */
+typedef struct {
+    /* stored pushes and bytes, the overwritten and spilled ones are included */
+    uint64_t pushes;
+    uint64_t bytes;
+    /* pushes dropped whole, the timed out ones are included */
+    uint64_t drops;
+    /* pushes stored partly */
+    uint64_t truncations;
+    /* pushes which overwrote the oldest data or went to the spill file */
+    uint64_t overwrites;
+    uint64_t spills;
+    /* max used size of the ring buffer seen by producers */
+    size_t high_water;
+    /* output thread wakeups from parking */
+    uint64_t wakeups;
+    /* time waiting for the output lock */
+    uint64_t lock_wait_ns;
+    /* time producers waiting for the earlier producers to commit */
+    uint64_t commit_wait_ns;
+    /* fifo_push and fifo_write duration */
+    FifoHist push_ns;
+    /* time from push to the pop callbacks, it needs FIFO_FLAG_TIMESTAMP */
+    FifoHist latency_ns;
+} FifoStats;
+#endif /* FIFO_USING_STATS */
+
+/* fifo instance, every instance owns its ring buffer, lock, notice and output thread */
+typedef struct fifo_instance fifo_t;
+
+/* output sink, it takes the output over from the callbacks and releases the ring buffer space itself.
+ * only the output thread calls it */
+typedef struct fifo_sink FifoSink;
+struct fifo_sink {
+    /* write a batch, it is passed like fp_fifo_pop_iov. release is the ring buffer space the batch holds,
+     * the sink passes it to fifo_release_h in batch order after the batch is written, so iov stays valid.
+     * in_ring false: iov points to a buffer reused after the call, the sink writes it before returning */
+    void (*write)(FifoSink *sink, fifo_t *fifo, const struct iovec *iov, int iovcnt, size_t release, bool in_ring);
+    /* the output thread is idle or exits, finish the writes in flight and release all held space.
+     * idle: the thread parks after it, the sink may keep output back and return the ms to keep it,
+     * the thread calls flush again by then. 0: nothing is kept. the last call on exit is not idle */
+    uint32_t (*flush)(FifoSink *sink, fifo_t *fifo, bool idle);
+};
+
+/* notice of the consumer which waits for the committed log. the port implements FifoNotifyType with it,
+ * an event loop can plug in its own to learn that an instance without output thread has log to poll */
+typedef struct fifo_notifier FifoNotifier;
+struct fifo_notifier {
+    /* a commit found the consumer parked, the ring buffer is not empty any more. producers call it */
+    void (*notify)(FifoNotifier *notifier, fifo_t *fifo);
+    /* wait for a notice on the output thread, timeout 0 means forever, it returns false on timeout.
+     * NULL with FIFO_FLAG_NO_THREAD */
+    bool (*wait)(FifoNotifier *notifier, fifo_t *fifo, uint32_t timeout_ms);
+    /* take a posted notice without waiting before draining, NULL: nothing is kept */
+    void (*clear)(FifoNotifier *notifier, fifo_t *fifo);
+    /* fd which is readable while a notice is posted, -1 or NULL: none */
+    int (*get_fd)(FifoNotifier *notifier, fifo_t *fifo);
+};
+
+/* scheduling policy of the output thread */
+typedef enum {
+    /* the port default, posix inherits the policy of the creating thread */
+    FIFO_SCHED_DEFAULT,
+    /* time sharing, the priority is not used */
+    FIFO_SCHED_OTHER,
+    /* real time policies with the priority, they need the privilege */
+    FIFO_SCHED_FIFO,
+    FIFO_SCHED_RR,
+} FifoSchedPolicy;
+
+/* CPUs of the output thread affinity */
+#define FIFO_THREAD_CPUS_MAX                 256
+
+/* output thread configuration, the zero value is the port default */
+typedef struct {
+    /* CPUs the output thread runs on, bit n % 64 of word n / 64 is CPU n, all zero: any CPU.
+     * a housekeeping CPU keeps the drain from preempting the producers */
+    uint64_t cpus[FIFO_THREAD_CPUS_MAX / 64];
+    /* only run on the isolated CPUs (isolcpus=) among the cpus, or on all of them when cpus is empty.
+     * the scheduler places nothing else there. it fails when there is no such CPU */
+    bool isolated;
+    FifoSchedPolicy policy;
+    /* priority of FIFO_SCHED_FIFO and FIFO_SCHED_RR, the task priority on FreeRTOS, 0: lowest or port default */
+    int priority;
+    /* stack size in bytes, it is raised to the port minimum, 0: port default */
+    size_t stack_size;
+    /* thread name, posix keeps the first 15 characters, NULL: "fifo_output" */
+    const char *name;
+} FifoThreadCfg;
+
+/* fifo instance configuration */
+typedef struct {
+    FifoCallbacks callbacks;
+    /* FIFO_FLAG_xxx */
+    uint32_t flags;
+    /* ring buffer size, it is rounded up to power of 2, 0: OUTPUT_BUF_SIZE */
+    size_t capacity;
+    /* notice of the output thread */
+    FifoNotifyType notify;
+    /* notice instead of the notify type, it needs the wait function unless FIFO_FLAG_NO_THREAD.
+     * it can not reach the producers of other processes, so no shm_name. NULL: the notify type */
+    FifoNotifier *notifier;
+    /* the output thread spins for new data before it parks, 0: park at once */
+    uint32_t spin_us;
+    /* ring buffer full policy */
+    FifoOverflow overflow;
+    /* FIFO_OVERFLOW_BLOCK wait time, 0: wait forever */
+    uint32_t block_timeout_ms;
+    /* FIFO_OVERFLOW_SPILL file, it is truncated on create */
+    const char *spill_path;
+    /* file backed ring buffer, the unread data survives a crash and is output again by the next create.
+     * it needs a port with file mapping, NULL: memory only */
+    const char *ring_path;
+    /* POSIX shared memory ring buffer name like "/name", the producers of other processes push to it.
+     * it needs a port with process shared locks and FIFO_OVERFLOW_DROP, NULL: private */
+    const char *shm_name;
+    /* output sink instead of the callbacks, NULL: callbacks */
+    FifoSink *sink;
+    /* output thread, every shard of a group uses it */
+    FifoThreadCfg thread;
+    /* FIFO_FLAG_NO_THREAD: the push which fills the ring buffer to this size drains it inline, 0: never */
+    size_t high_water;
+} FifoCfg;
+
+/* instance group, the stream is sharded over several instances so the producers do not share a ring buffer
+ * and the slow callbacks run on several output threads */
+typedef struct fifo_group fifo_group_t;
+
+/* instance group configuration */
+typedef struct {
+    /* configuration of every shard, the capacity is per shard. file and shared memory rings are not supported,
+     * a sink only works with a merged order where one thread calls it */
+    FifoCfg shard;
+    /* shards count, 1 to FIFO_GROUP_SHARDS_MAX, 0: one for each CPU with FIFO_SHARD_CPU */
+    uint32_t shards;
+    FifoOrder order;
+    FifoShardBy shard_by;
+} FifoGroupCfg;
+
+/* fsync policy of the file sink */
+typedef enum {
+    /* the kernel writes the data back */
+    FIFO_FSYNC_NONE,
+    /* before a file is rotated or closed */
+    FIFO_FSYNC_ROTATE,
+    /* every fsync_ms, and before a file is rotated or closed */
+    FIFO_FSYNC_INTERVAL,
+    /* every write, the space is released after the data is on disk */
+    FIFO_FSYNC_ALWAYS,
+} FifoFsync;
+
+/* file sink configuration */
+typedef struct {
+    /* output file, it is appended. a rotated file is renamed to path.1, path.2 ... */
+    const char *path;
+    /* rotate when the file reaches this size, 0: never */
+    uint64_t rotate_size;
+    /* rotate when the file is open for this time, 0: never */
+    uint32_t rotate_ms;
+    FifoFsync fsync;
+    /* FIFO_FSYNC_INTERVAL period */
+    uint32_t fsync_ms;
+    /* writes in flight, 0: default */
+    uint32_t queue_depth;
+    /* O_DIRECT, the data is copied to aligned buffers and the space is released at once */
+    bool direct;
+    /* synchronous writev even when io_uring is available */
+    bool no_uring;
+} FifoFileSinkCfg;
+
+/* compression sink configuration */
+typedef struct {
+    /* the compressed blocks are written to it, like the file sink */
+    FifoSink *next;
+    /* raw size of a block, 0: FIFO_LZ_BLOCK_SIZE */
+    size_t block_size;
+    /* an idle output thread keeps a partial block for this time so it fills more, 0: written at once */
+    uint32_t hold_ms;
+} FifoLzSinkCfg;
+
+/* compression sink statistics */
+typedef struct {
+    /* data size before and after compression, the block headers are included after */
+    uint64_t raw_bytes;
+    uint64_t block_bytes;
+    uint64_t blocks;
+} FifoLzSinkStats;
+
 /* fifo.c */
+fifo_t *fifo_create(const FifoCfg *cfg);
+fifo_t *fifo_create_ex(const FifoCfg *cfg, FifoErrCode *result);
+void fifo_destroy(fifo_t *fifo);
+FifoErrCode fifo_push_h(fifo_t *fifo, const char *format, ...);
+FifoErrCode fifo_vpush_h(fifo_t *fifo, const char *format, va_list args);
+FifoErrCode fifo_write_h(fifo_t *fifo, const char *buf, size_t size);
+FifoErrCode fifo_dpush_args_h(fifo_t *fifo, const char *format, const uint8_t *types, size_t count, ...);
+void *fifo_reserve_h(fifo_t *fifo, size_t size);
+FifoErrCode fifo_commit_h(fifo_t *fifo, size_t size);
+void fifo_peek_h(fifo_t *fifo, const char **ptr, size_t *size);
+void fifo_release_h(fifo_t *fifo, size_t size);
+size_t fifo_get_dropped_h(fifo_t *fifo);
+void fifo_get_offsets_h(fifo_t *fifo, uint64_t *read, uint64_t *commit);
+uint64_t fifo_get_wall_offset(void);
+size_t fifo_poll_h(fifo_t *fifo, size_t max_bytes);
+size_t fifo_poll(size_t max_bytes);
+int fifo_get_fd_h(fifo_t *fifo);
+int fifo_get_fd(void);
+size_t fifo_drain_nonblocking_h(fifo_t *fifo);
+size_t fifo_drain_nonblocking(void);
+
+/* fifo_group.c */
+fifo_group_t *fifo_group_create(const FifoGroupCfg *cfg);
+void fifo_group_destroy(fifo_group_t *group);
+fifo_t *fifo_group_shard(fifo_group_t *group);
+fifo_t *fifo_group_shard_key(fifo_group_t *group, uint64_t key);
+FifoErrCode fifo_group_push(fifo_group_t *group, const char *format, ...);
+FifoErrCode fifo_group_write(fifo_group_t *group, const char *buf, size_t size);
+
+/* the default instance */
 FifoErrCode fifo_init(FifoCallbacks *callbacks);
 void fifo_deinit(void);
 void fifo_start(void);
 void fifo_stop(void);
 
-void fifo_push(const char *format, ...);
+FifoErrCode fifo_push(const char *format, ...);
+FifoErrCode fifo_write(const char *buf, size_t size);
+FifoErrCode fifo_dpush_args(const char *format, const uint8_t *types, size_t count, ...);
+void *fifo_reserve(size_t size);
+FifoErrCode fifo_commit(size_t size);
+void fifo_peek(const char **ptr, size_t *size);
+void fifo_release(size_t size);
+#ifdef FIFO_USING_STATS
+FifoErrCode fifo_get_stats(FifoStats *stats);
+
+/* fifo_stats.c */
+FifoErrCode fifo_get_stats_h(fifo_t *fifo, FifoStats *stats);
+uint64_t fifo_hist_percentile(const FifoHist *hist, double percentile);
+#endif
+
+/* fifo_sink_file.c, linux only */
+FifoSink *fifo_file_sink_create(const FifoFileSinkCfg *cfg);
+void fifo_file_sink_destroy(FifoSink *sink);
+uint64_t fifo_file_sink_get_errors(FifoSink *sink);
+
+/* fifo_sink_lz.c */
+FifoSink *fifo_lz_sink_create(const FifoLzSinkCfg *cfg);
+void fifo_lz_sink_destroy(FifoSink *sink);
+void fifo_lz_sink_get_stats(FifoSink *sink, FifoLzSinkStats *stats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,251 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: C++17 typed channel on the fifo ring buffer, header only.
+ * Created on: 2026-10-17
+ */
+
+#ifndef __FIFO_HPP__
+#define __FIFO_HPP__
+
+#include "fifo.h"
+#include "fifo_file.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace fifo {
+
+/**
+ * typed channel, every element is a framed record constructed in place in the ring buffer. any thread pushes,
+ * one consumer thread drains it, no output thread runs and nothing is allocated per element.
+ * a push fails when the channel holds Capacity elements, like FIFO_OVERFLOW_DROP.
+ *
+ * @tparam T element type, the alignment is up to FIFO_REC_ALIGN_SIZE
+ * @tparam Capacity elements the channel holds. the ring buffer is at least that large, the port may round it
+ *         up to its page size, so the element count is kept besides
+ */
+template <typename T, std::size_t Capacity>
+class channel {
+    static_assert(alignof(T) <= FIFO_REC_ALIGN_SIZE, "the records are aligned to FIFO_REC_ALIGN_SIZE");
+    static_assert(sizeof(T) <= UINT32_MAX, "a record holds up to 4 GiB");
+    static_assert(Capacity > 0, "the channel holds one element at least");
+
+    static constexpr bool is_pow2(std::size_t size) {
+        return size && !(size & (size - 1));
+    }
+
+public:
+    /* ring buffer space of an element */
+    static constexpr std::size_t record_size = FIFO_REC_ALIGN(sizeof(FifoRecHdr) + sizeof(T));
+    /* a trivially copyable element is copied in with one memcpy, no reservation is held */
+    static constexpr bool memcpy_push = std::is_trivially_copyable_v<T>;
+    /* a power of 2 record never reaches over the end of the storage, so no padding record is written.
+     * with memcpy_push no empty record is either, then the records are drained without checks */
+    static constexpr bool unchecked_drain = memcpy_push && is_pow2(record_size);
+
+    /**
+     * @param flags FIFO_FLAG_SINGLE_PRODUCER, FIFO_FLAG_HUGE_PAGE and FIFO_FLAG_MLOCK, the others are ignored
+     */
+    explicit channel(uint32_t flags = 0) {
+        FifoCfg cfg = {};
+
+        /* a padding record may take up to a record at the end of a storage which is not mirrored */
+        cfg.capacity = Capacity * record_size + (is_pow2(record_size) ? 0 : record_size);
+        cfg.flags = (flags & (FIFO_FLAG_SINGLE_PRODUCER | FIFO_FLAG_HUGE_PAGE | FIFO_FLAG_MLOCK))
+                | FIFO_FLAG_FRAMED | FIFO_FLAG_NO_THREAD;
+        cfg.overflow = FIFO_OVERFLOW_DROP;
+        fifo_ = fifo_create(&cfg);
+    }
+
+    /* the elements left are destroyed */
+    ~channel() {
+        if (fifo_) {
+            drain([](T &) {});
+            fifo_destroy(fifo_);
+        }
+    }
+
+    channel(const channel &) = delete;
+    channel &operator=(const channel &) = delete;
+
+    /* false when the instance is not created, every push fails then */
+    explicit operator bool() const {
+        return fifo_ != nullptr;
+    }
+
+    /* the instance for the statistics and fifo_get_dropped_h */
+    fifo_t *handle() const {
+        return fifo_;
+    }
+
+    /**
+     * construct an element in the ring buffer
+     * @note a thread holds one reservation at a time, it fails while the thread holds one of fifo_reserve_h
+     *
+     * @return false when the channel is full
+     */
+    template <typename... Args>
+    bool emplace(Args &&...args) {
+        if constexpr (memcpy_push) {
+            const T value(std::forward<Args>(args)...);
+
+            if (!take_slot()) {
+                return false;
+            }
+            if (fifo_write_h(fifo_, reinterpret_cast<const char *>(&value), sizeof(T)) != FIFO_NO_ERR) {
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        } else {
+            void *ptr;
+
+            if (!take_slot()) {
+                return false;
+            }
+            ptr = fifo_reserve_h(fifo_, sizeof(T));
+            if (!ptr) {
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+#if defined(__cpp_exceptions)
+            try {
+                new (ptr) T(std::forward<Args>(args)...);
+            } catch (...) {
+                /* the empty record is skipped by the drain */
+                fifo_commit_h(fifo_, 0);
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                throw;
+            }
+#else
+            new (ptr) T(std::forward<Args>(args)...);
+#endif
+            fifo_commit_h(fifo_, sizeof(T));
+            return true;
+        }
+    }
+
+    /* elements in the channel, the pushes being constructed are counted */
+    std::size_t size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * move an element in, a move only type works
+     *
+     * @return false when the channel is full, the value is not moved from then
+     */
+    bool try_push(T &&value) {
+        return emplace(std::move(value));
+    }
+
+    bool try_push(const T &value) {
+        return emplace(value);
+    }
+
+    /**
+     * call f with every element in push order, the element is in the ring buffer and is destroyed after f returns.
+     * only one thread drains. an element f throws on stays in the channel
+     *
+     * @param f callable with T &, it may move the element out
+     * @param max elements to drain at most
+     *
+     * @return drained elements
+     */
+    template <typename F>
+    std::size_t drain(F &&f, std::size_t max = SIZE_MAX) {
+        /* the done space is released when f throws too, then the slots of its elements are given back */
+        struct release_guard {
+            fifo_t *fifo;
+            std::atomic<std::size_t> &slots;
+            std::size_t size;
+            std::size_t count;
+            ~release_guard() {
+                if (size) {
+                    fifo_release_h(fifo, size);
+                }
+                if (count) {
+                    slots.fetch_sub(count, std::memory_order_relaxed);
+                }
+            }
+        };
+        const char *ptr;
+        std::size_t size, count = 0;
+
+        while (count < max) {
+            /* the committed data is whole records, a record never reaches over the end of the storage */
+            fifo_peek_h(fifo_, &ptr, &size);
+            if (!size) {
+                break;
+            }
+            release_guard done = { fifo_, size_, 0, 0 };
+            while (done.size < size && count < max) {
+                const FifoRecHdr *hdr = reinterpret_cast<const FifoRecHdr *>(ptr + done.size);
+
+                if constexpr (!unchecked_drain) {
+                    if (hdr->type == FIFO_REC_PAD) {
+                        done.size += sizeof(FifoRecHdr) + hdr->size;
+                        continue;
+                    }
+                    if (hdr->size != sizeof(T)) {
+                        done.size += FIFO_REC_ALIGN(sizeof(FifoRecHdr) + hdr->size);
+                        continue;
+                    }
+                }
+                T *elem = std::launder(reinterpret_cast<T *>(const_cast<char *>(ptr) + done.size + sizeof(FifoRecHdr)));
+                f(*elem);
+                if constexpr (!std::is_trivially_destructible_v<T>) {
+                    elem->~T();
+                }
+                done.size += record_size;
+                done.count++;
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+private:
+    /* the slot is taken before the ring buffer space, the drain gives it back after the release */
+    bool take_slot() {
+        if (size_.fetch_add(1, std::memory_order_relaxed) >= Capacity) {
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    fifo_t *fifo_ = nullptr;
+    /* written by every push and the drain, away from the read only handle */
+    alignas(64) std::atomic<std::size_t> size_{0};
+};
+
+} /* namespace fifo */
+
+#endif /* __FIFO_HPP__ */
@@ -0,0 +1,100 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Storage format of the file and shared memory ring buffers and the framed records, for the offline readers.
+ * Created on: 2026-10-17
+ */
+
+#ifndef __FIFO_FILE_H__
+#define __FIFO_FILE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "FIFO" in little endian */
+#define FIFO_FILE_MAGIC                      0x4F464946
+#define FIFO_FILE_VERSION                    2
+
+/* records of the framed mode start at this alignment, a padding record is not aligned */
+#define FIFO_REC_ALIGN_SIZE                  8
+#define FIFO_REC_ALIGN(size)                 (((size) + FIFO_REC_ALIGN_SIZE - 1) & ~(size_t)(FIFO_REC_ALIGN_SIZE - 1))
+
+/* record types of the framed mode */
+#define FIFO_REC_DATA                        0
+/* padding record, the consumer skips it */
+#define FIFO_REC_PAD                         1
+/* deferred formatting record, the consumer formats it before output.
+ * the format string pointer is only valid in the writer process */
+#define FIFO_REC_DEFERRED                    2
+
+/* record header of the framed mode, the optional sequence number and timestamp follow it.
+ * a record never wraps around the end of the storage, a padding record fills the end instead */
+typedef struct {
+    /* payload size, or the skipped size after the header of a padding record */
+    uint32_t size;
+    /* FIFO_REC_xxx */
+    uint16_t type;
+    uint16_t reserved;
+} FifoRecHdr;
+
+/* file or shared memory ring buffer header, it is in the first page, the storage follows it at data_offset */
+typedef struct {
+    /* FIFO_FILE_MAGIC, it is written last when the file is initialized */
+    uint32_t magic;
+    /* FIFO_FILE_VERSION */
+    uint32_t version;
+    /* storage file offset, a multiple of page size */
+    uint64_t data_offset;
+    /* storage size, power of 2 */
+    uint64_t capacity;
+    /* FIFO_FLAG_xxx of the writer, FIFO_FLAG_FRAMED, FIFO_FLAG_SEQ and FIFO_FLAG_TIMESTAMP decide the record format */
+    uint32_t flags;
+    uint32_t reserved[9];
+    /* free running indices, the storage offset is index & (capacity - 1).
+     * [cons_tail, prod_tail) is unread, [prod_tail, prod_head) is reserved but not committed.
+     * the producer, commit, consumer and parking state are on their own 64 byte lines */
+    uint64_t prod_head;
+    /* read index last seen by the producers, not newer than cons_tail */
+    uint64_t cons_cache;
+    uint64_t reserved2[6];
+    uint64_t prod_tail;
+    /* next record sequence number */
+    uint64_t seq;
+    uint64_t reserved3[6];
+    uint64_t cons_tail;
+    uint64_t reserved4[7];
+    /* the output thread is waiting for the notice */
+    uint32_t consumer_parked;
+    uint32_t reserved5[15];
+} FifoFileHdr;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FIFO_FILE_H__ */
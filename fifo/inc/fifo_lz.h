@@ -0,0 +1,78 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: In-tree LZ codec of the compression sink and the block format of its output, for the offline readers.
+ * Created on: 2026-10-17
+ */
+
+#ifndef __FIFO_LZ_H__
+#define __FIFO_LZ_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "FLZB" in little endian */
+#define FIFO_LZ_MAGIC                        0x425A4C46
+
+/* default raw size of a block */
+#define FIFO_LZ_BLOCK_SIZE                   (64 * 1024)
+/* the raw size of a block is limited by the 32 bit header fields */
+#define FIFO_LZ_BLOCK_SIZE_MAX               (64 * 1024 * 1024)
+
+/* compressor hash table, it is passed as the work memory */
+#define FIFO_LZ_HASH_BITS                    12
+#define FIFO_LZ_WORK_SIZE                    ((1 << FIFO_LZ_HASH_BITS) * sizeof(uint32_t))
+
+/* compressed size of incompressible data in the worst case */
+#define FIFO_LZ_BOUND(size)                  ((size) + (size) / 255 + 16)
+
+/* block flags */
+/* the payload is stored raw, it did not compress */
+#define FIFO_LZ_BLOCK_RAW                    (1 << 0)
+
+/* block header, the payload follows it. the blocks are concatenated in the output */
+typedef struct {
+    /* FIFO_LZ_MAGIC */
+    uint32_t magic;
+    /* FIFO_LZ_BLOCK_xxx */
+    uint32_t flags;
+    /* size before compression */
+    uint32_t raw_size;
+    /* payload size */
+    uint32_t size;
+} FifoLzBlockHdr;
+
+/* fifo_lz.c */
+size_t fifo_lz_compress(const void *src, size_t size, void *dst, size_t capacity, void *work);
+size_t fifo_lz_decompress(const void *src, size_t size, void *dst, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FIFO_LZ_H__ */
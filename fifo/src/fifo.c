@@ -28,68 +28,318 @@
 
 #define LOG_TAG      "fifo"
 
-#include <fifo.h>
+#include "fifo_def.h"
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 /* buffer size for every line's log */
 #define FIFO_ONE_MSG_MAX_SIZE                       1024*8
+/* busy waiting times before a producer yields the CPU to the earlier producer it waits for */
+#define FIFO_COMMIT_SPIN_TIMES                      128
+/* the output thread formats the deferred records of a batch into a buffer of this size */
+#define FIFO_FMT_BUF_SIZE                           (FIFO_ONE_MSG_MAX_SIZE * 4)
+/* spill file replay size at a time in stream mode */
+#define FIFO_SPILL_CHUNK_SIZE                       OUTPUT_BUF_SIZE
 
-/* fifo */
+/* the free running indices are reduced by mask, the capacity must wrap together with size_t */
+_Static_assert((OUTPUT_BUF_SIZE & (OUTPUT_BUF_SIZE - 1)) == 0, "OUTPUT_BUF_SIZE must be power of 2");
+
+/* default fifo instance for fifo_init and fifo_push */
+static fifo_t *s_fifo = NULL;
+/* format buffer, every producer thread has its own one so formatting needs no lock */
+static FIFO_THREAD_LOCAL char log_buf[FIFO_ONE_MSG_MAX_SIZE];
+/* a reserved space of the ring buffer */
+typedef struct {
+    fifo_t *fifo;
+    /* start index of the reserved space, the padding record is included in framed mode */
+    size_t head;
+    /* reserved size */
+    size_t size;
+    /* start index of the record header in framed mode */
+    size_t rec;
+    /* space to write the payload */
+    char *ptr;
+    /* payload size requested by the producer */
+    size_t cap;
+} FifoResv;
+
+/* the reservation of this thread between fifo_reserve_h and fifo_commit_h */
+static FIFO_THREAD_LOCAL FifoResv s_resv;
+/* staging buffer for a reserved space which wraps around the end of the storage */
+static FIFO_THREAD_LOCAL char resv_buf[FIFO_ONE_MSG_MAX_SIZE];
+
+/* record header of the spill file in framed mode */
 typedef struct {
-    bool init_ok;
-    bool output_enabled;
-    bool output_lock_enabled;
-    bool output_is_locked_before_enable;
-    bool output_is_locked_before_disable;
-}fifo, *Fifo_t;
-
-/* log ring buffer write index */
-static size_t write_index = 0;
-/* log ring buffer read index */
-static size_t read_index = 0;
-/* log ring buffer full flag */
-static bool buf_is_full = false;
-/* log ring buffer empty flag */
-static bool buf_is_empty = true;
-
-/* fifo object */
-static fifo s_fifo;
-static char log_buf[FIFO_ONE_MSG_MAX_SIZE] = { 0 };
-FifoCallbacks usr_cbs;
-
-static void fifo_set_output_enabled(bool enabled);
-static void fifo_output_lock_enabled(bool enabled);
-extern void fifo_async_put_notice(void);
+    uint32_t size;
+    uint32_t reserved;
+    /* push time, it is valid with FIFO_FLAG_TIMESTAMP */
+    uint64_t timestamp;
+} FifoSpillHdr;
+
+static void fifo_set_output_enabled(fifo_t *fifo, bool enabled);
+static void fifo_output_lock_enabled(fifo_t *fifo, bool enabled);
+
 /**
- * fifo initialize.
+ * round the ring buffer capacity up to power of 2
  *
- * @return result
+ * @param size requested capacity
+ *
+ * @return capacity, 0 when it is too large
  */
-FifoErrCode fifo_init(FifoCallbacks *cb) {
+static size_t fifo_capacity_align(size_t size) {
+    size_t capacity = 1;
 
-    usr_cbs.fp_fifo_pop = cb->fp_fifo_pop; // add callback for output
+    while (capacity < size) {
+        capacity <<= 1;
+        if (!capacity) {
+            return 0;
+        }
+    }
 
-    FifoErrCode result = FIFO_NO_ERR;
+    return capacity;
+}
 
-    if (s_fifo.init_ok == true) {
-        return result;
+/**
+ * free the instance memory and files, the output thread is stopped
+ *
+ * @param fifo instance
+ */
+static void fifo_free(fifo_t *fifo) {
+    if (fifo->spill_file) {
+        fclose(fifo->spill_file);
     }
-    extern FifoErrCode fifo_async_init(void);
-    result = fifo_async_init();
-    if (result != FIFO_NO_ERR) {
-        return result;
+    free(fifo->spill_buf);
+    free(fifo->copy_buf);
+    free(fifo->fmt_buf);
+    fifo_stats_deinit(fifo);
+    fifo_platform_buf_free(fifo);
+    free(fifo);
+}
+
+/**
+ * create a fifo instance, its output thread starts running and output is enabled
+ *
+ * @param cfg configuration
+ *
+ * @return instance, NULL when no memory or the platform initialize failed
+ */
+fifo_t *fifo_create(const FifoCfg *cfg) {
+    return fifo_create_shard(cfg, NULL, 0, NULL);
+}
+
+/**
+ * create a fifo instance like fifo_create, and tell why it failed
+ *
+ * @param cfg configuration
+ * @param result FIFO_NO_ERR, or the reason of the failure, NULL: not needed
+ *
+ * @return instance, NULL when failed
+ */
+fifo_t *fifo_create_ex(const FifoCfg *cfg, FifoErrCode *result) {
+    return fifo_create_shard(cfg, NULL, 0, result);
+}
+
+/**
+ * set the create result
+ *
+ * @param result result storage, NULL: not needed
+ * @param code result code
+ *
+ * @return NULL for the failed create
+ */
+static fifo_t *fifo_create_result(FifoErrCode *result, FifoErrCode code) {
+    if (result) {
+        *result = code;
+    }
+
+    return NULL;
+}
+
+/**
+ * create an instance, or a shard of an instance group
+ *
+ * @param cfg configuration
+ * @param group instance group, NULL: standalone instance
+ * @param index shard index in the group
+ * @param result FIFO_NO_ERR, or the reason of the failure, NULL: not needed
+ *
+ * @return instance, NULL when failed
+ */
+fifo_t *fifo_create_shard(const FifoCfg *cfg, struct fifo_group *group, size_t index, FifoErrCode *result) {
+    /* the ring state lines are aligned in the instance */
+    fifo_t *fifo = aligned_alloc(FIFO_CACHE_LINE_SIZE, sizeof(fifo_t));
+    FifoErrCode code;
+
+    if (!fifo) {
+        return fifo_create_result(result, FIFO_ERR_NO_MEM);
+    }
+    memset(fifo, 0, sizeof(fifo_t));
+
+    fifo->cbs = cfg->callbacks; // add callback for output
+    fifo->sink = cfg->sink;
+    fifo->flags = cfg->flags;
+    fifo->notify = cfg->notify;
+    fifo->notifier = cfg->notifier;
+    fifo->spin_ns = (uint64_t)cfg->spin_us * 1000;
+    fifo->capacity = fifo_capacity_align(cfg->capacity ? cfg->capacity : OUTPUT_BUF_SIZE);
+    fifo->ring = &fifo->ring_local;
+    atomic_init(&fifo->ring->prod_head, 0);
+    atomic_init(&fifo->ring->cons_cache, 0);
+    atomic_init(&fifo->ring->prod_tail, 0);
+    atomic_init(&fifo->ring->cons_tail, 0);
+    atomic_init(&fifo->ring->consumer_parked, false);
+    fifo->ring_path = cfg->ring_path;
+    fifo->shm_name = cfg->shm_name;
+    fifo->overflow = cfg->overflow;
+    fifo->block_timeout_ns = (uint64_t)cfg->block_timeout_ms * 1000000;
+    atomic_init(&fifo->space_waiters, 0);
+    atomic_init(&fifo->dropped, 0);
+    atomic_init(&fifo->spill_active, false);
+    atomic_init(&fifo->polling, false);
+    atomic_init(&fifo->notice_armed, false);
+
+    if (fifo->shm_name) {
+        /* the producers of all processes take the port producer lock, so they run the single producer path.
+         * the other policies need the state of the collector process, only dropping works across processes */
+        fifo->shared = true;
+        fifo->flags |= FIFO_FLAG_SINGLE_PRODUCER;
+        fifo->notify = FIFO_NOTIFY_SEM;
+        if (fifo->overflow != FIFO_OVERFLOW_DROP || fifo->ring_path || fifo->notifier) {
+            free(fifo);
+            return fifo_create_result(result, FIFO_ERR_INVALID);
+        }
+    }
+    if ((fifo->flags & FIFO_FLAG_SHM_PRODUCER) && !fifo->shared) {
+        free(fifo);
+        return fifo_create_result(result, FIFO_ERR_INVALID);
+    }
+    fifo->thread = cfg->thread;
+    /* only the owner drains an instance without output thread */
+    fifo->high_water = (fifo->flags & FIFO_FLAG_NO_THREAD) ? cfg->high_water : 0;
+    fifo->numa_cpu = -1;
+    if (group) {
+        fifo->group = group;
+        group->shards[index] = fifo;
+        /* a CPU shard is mostly pushed by its CPU */
+        if (group->shard_by == FIFO_SHARD_CPU) {
+            fifo->numa_cpu = (int)index;
+        }
+    }
+    /* the output thread sleeps in the notifier */
+    if (fifo->notifier && !fifo->notifier->wait && fifo_has_output_thread(fifo)) {
+        if (group) {
+            group->shards[index] = NULL;
+        }
+        free(fifo);
+        return fifo_create_result(result, FIFO_ERR_INVALID);
+    }
+
+    /* a shared memory producer gets the capacity and the record format from the collector */
+    if (!fifo->capacity || fifo_platform_buf_alloc(fifo) != FIFO_NO_ERR) {
+        if (group) {
+            group->shards[index] = NULL;
+        }
+        free(fifo);
+        return fifo_create_result(result, FIFO_ERR_NO_MEM);
+    }
+    /* a recovered ring buffer is output from its read index */
+    fifo->cons_head = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_relaxed);
+    fifo->rec_hdr_size = sizeof(FifoRecHdr);
+    if (fifo->flags & FIFO_FLAG_SEQ) {
+        fifo->rec_hdr_size += sizeof(uint64_t);
+    }
+    if (fifo->flags & FIFO_FLAG_TIMESTAMP) {
+        fifo->rec_hdr_size += sizeof(uint64_t);
+    }
+
+    if (fifo_stats_init(fifo) != FIFO_NO_ERR
+            || (fifo->overflow == FIFO_OVERFLOW_OVERWRITE && !(fifo->copy_buf = malloc(fifo->capacity)))
+            || (fifo->overflow == FIFO_OVERFLOW_SPILL
+                    && (!cfg->spill_path || !(fifo->spill_file = fopen(cfg->spill_path, "w+b"))))) {
+        code = FIFO_ERR_NO_MEM;
+    } else {
+        code = fifo_async_init(fifo);
+    }
+    if (code != FIFO_NO_ERR) {
+        if (group) {
+            group->shards[index] = NULL;
+        }
+        fifo_free(fifo);
+        return fifo_create_result(result, code);
     }
 
     /* enable the output lock */
-    fifo_output_lock_enabled(true);
+    fifo_output_lock_enabled(fifo, true);
     /* output locked status initialize */
-    s_fifo.output_is_locked_before_enable = false;
-    s_fifo.output_is_locked_before_disable = false;
-    s_fifo.init_ok = true;
+    fifo->output_is_locked_before_enable = false;
+    fifo->output_is_locked_before_disable = false;
+    /* a plugged notifier is told at once, the first fifo_poll_h outputs a recovered ring buffer and parks */
+    if (cfg->notifier && (fifo->flags & FIFO_FLAG_NO_THREAD) && fifo_drainer(fifo) == fifo) {
+        atomic_store_explicit(&fifo->notice_armed, true, memory_order_relaxed);
+        fifo_notice_put(fifo);
+    }
+    /* enable output */
+    fifo_set_output_enabled(fifo, true);
+    fifo_create_result(result, FIFO_NO_ERR);
 
-    return result;
+    return fifo;
+}
+
+/**
+ * destroy a fifo instance, the output thread outputs the remaining log before exit.
+ * without output thread the remaining log is output to the callbacks or the sink here
+ *
+ * @param fifo instance
+ */
+void fifo_destroy(fifo_t *fifo) {
+    if (!fifo) {
+        return;
+    }
+
+    fifo_set_output_enabled(fifo, false);
+    /* the first shard of a merged group has drained the others before */
+    if ((fifo->flags & FIFO_FLAG_NO_THREAD) && fifo_drainer(fifo) == fifo) {
+        fifo_poll_h(fifo, 0);
+        if (fifo->sink && fifo->sink->flush) {
+            fifo->sink->flush(fifo->sink, fifo, false);
+        }
+    }
+    fifo_async_deinit(fifo);
+    fifo_free(fifo);
+}
+
+/**
+ * fifo initialize.
+ *
+ * @return result
+ */
+FifoErrCode fifo_init(FifoCallbacks *cb) {
+    FifoCfg cfg = { 0 };
+    FifoErrCode result;
+
+    if (s_fifo) {
+        return FIFO_NO_ERR;
+    }
+
+    cfg.callbacks = *cb;
+#ifdef FIFO_SINGLE_PRODUCER
+    cfg.flags |= FIFO_FLAG_SINGLE_PRODUCER;
+#endif
+#ifdef FIFO_NO_THREAD
+    /* the eventfd is only written after fifo_get_fd */
+    cfg.flags |= FIFO_FLAG_NO_THREAD;
+    cfg.notify = FIFO_NOTIFY_EVENTFD;
+#endif
+    s_fifo = fifo_create_ex(&cfg, &result);
+    if (!s_fifo) {
+        return result;
+    }
+    /* output is enabled by fifo_start */
+    fifo_set_output_enabled(s_fifo, false);
+
+    return FIFO_NO_ERR;
 }
 
 /**
@@ -97,14 +347,12 @@ FifoErrCode fifo_init(FifoCallbacks *cb) {
  *
  */
 void fifo_deinit(void) {
-
-    if (!s_fifo.init_ok) {
+    if (!s_fifo) {
         return ;
     }
-    extern FifoErrCode fifo_async_deinit(void);
-    fifo_async_deinit();
 
-    s_fifo.init_ok = false;
+    fifo_destroy(s_fifo);
+    s_fifo = NULL;
 }
 
 
@@ -112,12 +360,12 @@ void fifo_deinit(void) {
  * fifo start after initialize.
  */
 void fifo_start(void) {
-    if (!s_fifo.init_ok) {
+    if (!s_fifo) {
         return ;
     }
     
     /* enable output */
-    fifo_set_output_enabled(true);
+    fifo_set_output_enabled(s_fifo, true);
     /* show version */
     printf("fifo V%s is initialize success.", FIFO_SW_VERSION);
 }
@@ -126,12 +374,12 @@ void fifo_start(void) {
  * fifo stop after initialize.
  */
 void fifo_stop(void) {
-    if (!s_fifo.init_ok) {
+    if (!s_fifo) {
         return ;
     }
 
     /* disable output */
-    fifo_set_output_enabled(false);
+    fifo_set_output_enabled(s_fifo, false);
 
     /* show version */
     printf("fifo V%s is deinitialize success.", FIFO_SW_VERSION);
@@ -141,236 +389,1876 @@ void fifo_stop(void) {
 /**
  * set output enable or disable
  *
+ * @param fifo instance
  * @param enabled TRUE: enable FALSE: disable
  */
-static void fifo_set_output_enabled(bool enabled) {
-    s_fifo.output_enabled = enabled;
+static void fifo_set_output_enabled(fifo_t *fifo, bool enabled) {
+    fifo->output_enabled = enabled;
 }
 
-extern void fifo_platform_output_lock(void);
-extern void fifo_platform_output_unlock(void);
 /**
  * lock output 
+ *
+ * @param fifo instance
  */
-void fifo_output_lock(void) {
-    if (s_fifo.output_lock_enabled) {
-        fifo_platform_output_lock();
-        s_fifo.output_is_locked_before_disable = true;
+void fifo_output_lock(fifo_t *fifo) {
+    uint64_t start;
+
+    if (fifo->output_lock_enabled) {
+        start = fifo_stats_now();
+        fifo_platform_output_lock(fifo);
+        fifo_stats_lock_wait(fifo, start);
+        fifo->output_is_locked_before_disable = true;
     } else {
-        s_fifo.output_is_locked_before_enable = true;
+        fifo->output_is_locked_before_enable = true;
     }
 }
 
 /**
  * unlock output
+ *
+ * @param fifo instance
  */
-void fifo_output_unlock(void) {
-    if (s_fifo.output_lock_enabled) {
-        fifo_platform_output_unlock();
-        s_fifo.output_is_locked_before_disable = false;
+void fifo_output_unlock(fifo_t *fifo) {
+    if (fifo->output_lock_enabled) {
+        fifo_platform_output_unlock(fifo);
+        fifo->output_is_locked_before_disable = false;
     } else {
-        s_fifo.output_is_locked_before_enable = false;
+        fifo->output_is_locked_before_enable = false;
     }
 }
 
 /**
- * asynchronous output ring buffer used size
+ * busy waiting hint for the CPU
+ */
+static inline void fifo_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * copy data into the ring buffer
  *
- * @return used size
+ * @param fifo instance
+ * @param index free running index of the data
+ * @param src source data
+ * @param size data size
  */
-static size_t fifo_async_get_buf_used(void) {
-    if (write_index > read_index) {
-        return write_index - read_index;
+static void fifo_buf_write(fifo_t *fifo, size_t index, const char *src, size_t size) {
+    size_t offset = index & (fifo->capacity - 1);
+
+    /* the mirrored storage is contiguous across the end */
+    if (fifo->buf_mirrored || offset + size <= fifo->capacity) {
+        memcpy(fifo->buf + offset, src, size);
     } else {
-        if (!buf_is_full && !buf_is_empty) {
-            return OUTPUT_BUF_SIZE - (read_index - write_index);
-        } else if (buf_is_full) {
-            return OUTPUT_BUF_SIZE;
-        } else {
-            return 0;
-        }
+        memcpy(fifo->buf + offset, src, fifo->capacity - offset);
+        memcpy(fifo->buf, src + fifo->capacity - offset, size - (fifo->capacity - offset));
     }
 }
 
 /**
- * get log from asynchronous output ring buffer
+ * copy data out of the ring buffer
  *
- * @param log get log buffer
- * @param size log size
+ * @param fifo instance
+ * @param index free running index of the data
+ * @param dst destination buffer
+ * @param size data size
+ */
+static void fifo_buf_read(fifo_t *fifo, size_t index, char *dst, size_t size) {
+    size_t offset = index & (fifo->capacity - 1);
+
+    if (fifo->buf_mirrored || offset + size <= fifo->capacity) {
+        memcpy(dst, fifo->buf + offset, size);
+    } else {
+        memcpy(dst, fifo->buf + offset, fifo->capacity - offset);
+        memcpy(dst + fifo->capacity - offset, fifo->buf, size - (fifo->capacity - offset));
+    }
+}
+
+/**
+ * asynchronous output ring buffer used size
+ *
+ * @return used size
+ */
+static size_t fifo_async_get_buf_used(fifo_t *fifo) {
+    size_t tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_relaxed);
+
+    return atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire) - tail;
+}
+
+/**
+ * committed data which the output thread has not output, of all shards when it merges a group
  *
- * @return get log size, the log size is less than ring buffer used size
+ * @return pending size
  */
-size_t fifo_async_get_log(char *log, size_t size) {
-    size_t used = 0;
-    /* lock output */
-    fifo_output_lock();
-    used = fifo_async_get_buf_used();
-    /* no log */
-    if (!used || !size) {
-        size = 0;
-        goto __exit;
+static size_t fifo_async_get_pending(fifo_t *fifo) {
+    size_t i, pending = 0;
+
+    if (!fifo_is_merger(fifo)) {
+        return atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire) - fifo->cons_head;
     }
-    /* less log */
-    if (used <= size) {
-        size = used;
-        buf_is_empty = true;
+    for (i = 0; i < fifo->group->count; i++) {
+        pending += atomic_load_explicit(&fifo->group->shards[i]->ring->prod_tail, memory_order_acquire)
+                - fifo->group->shards[i]->cons_head;
     }
 
-    if (read_index + size < OUTPUT_BUF_SIZE) {
-        memcpy(log, log_buf + read_index, size);
-        read_index += size;
-    } else {
-        memcpy(log, log_buf + read_index, OUTPUT_BUF_SIZE - read_index);
-        memcpy(log + OUTPUT_BUF_SIZE - read_index, log_buf,
-                size - (OUTPUT_BUF_SIZE - read_index));
-        read_index += size - OUTPUT_BUF_SIZE;
-    }
+    return pending;
+}
+
+/**
+ * peek the committed data of asynchronous output ring buffer, the data stays in the ring buffer
+ * @note only the consumer of the instance can call it, the committed data is read without lock.
+ *       it does not suit FIFO_OVERFLOW_OVERWRITE, producers may overwrite the peeked data.
+ *
+ * @param fifo instance
+ * @param ptr start of the contiguous committed data
+ * @param size contiguous committed data size, 0 means ring buffer is empty
+ */
+void fifo_peek_h(fifo_t *fifo, const char **ptr, size_t *size) {
+    size_t tail, offset, used;
 
-    buf_is_full = false;
+    tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_relaxed);
+    used = fifo_async_get_buf_used(fifo);
+    offset = tail & (fifo->capacity - 1);
+    /* the mirrored storage is contiguous across the end */
+    if (!fifo->buf_mirrored && offset + used > fifo->capacity) {
+        used = fifo->capacity - offset;
+    }
 
-__exit:
-    /* lock output */
-    fifo_output_unlock();
-    return size;
+    *ptr = fifo->buf + offset;
+    *size = used;
 }
 
 /**
- * asynchronous output ring buffer remain space
+ * release the peeked data, then producers can reuse the space
  *
- * @return remain space
+ * @param fifo instance
+ * @param size released size, it must not be larger than the peeked size
  */
-static size_t async_get_buf_space(void) {
-    return OUTPUT_BUF_SIZE - fifo_async_get_buf_used();
+void fifo_release_h(fifo_t *fifo, size_t size) {
+    size_t tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_relaxed);
+
+    atomic_store_explicit(&fifo->ring->cons_tail, tail + size, memory_order_release);
+
+    if (fifo->overflow == FIFO_OVERFLOW_BLOCK) {
+        /* pairs with the fence in async_wait_space, either the space or the waiter is seen */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&fifo->space_waiters, memory_order_relaxed)) {
+            fifo_output_lock(fifo);
+            fifo_async_put_space_notice(fifo);
+            fifo_output_unlock(fifo);
+        }
+    }
 }
 
 /**
- * put log to asynchronous output ring buffer
+ * free space after the reserve index, the read index is only read when the one cached by the producers
+ * shows less space than needed
  *
- * @param log put log buffer
- * @param size log size
+ * @param fifo instance
+ * @param head reserve index
+ * @param need needed size
+ * @param tail read index of the result
  *
- * @return put log size, the log which beyond ring buffer space will be dropped
+ * @return free space, 0 when the read index is observed newer than the reserve index
  */
-static size_t async_put_log(const char *log, size_t size) {
-    size_t space = 0;
+static size_t async_get_space(fifo_t *fifo, size_t head, size_t need, size_t *tail) {
+    size_t used;
 
-    space = async_get_buf_space();
-    /* no space */
-    if (!space) {
-        size = 0;
-        goto __exit;
+    /* acquire pairs with the release of the producer which cached it, so the consumer reads happen before */
+    *tail = atomic_load_explicit(&fifo->ring->cons_cache, memory_order_acquire);
+    used = head - *tail;
+    if (used >= fifo->capacity || fifo->capacity - used < need) {
+        *tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_acquire);
+        /* a slower producer may store an older one, it only costs another refresh */
+        atomic_store_explicit(&fifo->ring->cons_cache, *tail, memory_order_release);
+        used = head - *tail;
     }
-    /* drop some log */
-    if (space <= size) {
-        size = space;
-        buf_is_full = true;
+
+    /* the read index may be observed older than the reserve index, treat it as full */
+    return used < fifo->capacity ? fifo->capacity - used : 0;
+}
+
+/**
+ * reserve space in asynchronous output ring buffer
+ *
+ * @param fifo instance
+ * @param size log size, it will be decreased when the space is not enough
+ * @param head start index of the reserved space
+ * @param whole true: reserve nothing when the space is not enough
+ *
+ * @return reserved size, 0 means ring buffer is full
+ */
+static size_t async_reserve(fifo_t *fifo, size_t *size, size_t *head, bool whole) {
+    size_t tail, space;
+
+    if (fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) {
+        if (fifo->shared) {
+            fifo_platform_producer_lock(fifo);
+        }
+        /* the only producer owns the commit index, no one else moves it */
+        *head = atomic_load_explicit(&fifo->ring->prod_tail, memory_order_relaxed);
+        space = async_get_space(fifo, *head, *size, &tail);
+        /* drop some log */
+        if (space < *size) {
+            *size = whole ? 0 : space;
+        }
+        if (*size) {
+            fifo_stats_used(fifo, *head + *size - tail);
+            /* the reserve index tells the readers of a mapped file which space is being written */
+            atomic_store_explicit(&fifo->ring->prod_head, *head + *size, memory_order_relaxed);
+        } else if (fifo->shared) {
+            fifo_platform_producer_unlock(fifo);
+        }
+        return *size;
     }
 
-    if (write_index + size < OUTPUT_BUF_SIZE) {
-        memcpy(log_buf + write_index, log, size);
-        write_index += size;
-    } else {
-        memcpy(log_buf + write_index, log, OUTPUT_BUF_SIZE - write_index);
-        memcpy(log_buf, log + OUTPUT_BUF_SIZE - write_index,
-                size - (OUTPUT_BUF_SIZE - write_index));
-        write_index += size - OUTPUT_BUF_SIZE;
+    *head = atomic_load_explicit(&fifo->ring->prod_head, memory_order_relaxed);
+    do {
+        space = async_get_space(fifo, *head, *size, &tail);
+        /* no space */
+        if (!space || (whole && space < *size)) {
+            return 0;
+        }
+        /* drop some log */
+        if (space < *size) {
+            *size = space;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&fifo->ring->prod_head, head, *head + *size,
+            memory_order_relaxed, memory_order_relaxed));
+    fifo_stats_used(fifo, *head + *size - tail);
+
+    return *size;
+}
+
+/**
+ * commit reserved space, then the consumer can read it
+ *
+ * @param fifo instance
+ * @param head start index of the reserved space
+ * @param size reserved size
+ * @param seq where to store the record sequence number, NULL: no sequence number
+ */
+static void async_commit(fifo_t *fifo, size_t head, size_t size, char *seq) {
+    size_t spin = 0;
+    uint64_t start, value;
+
+    /* the commit index must be moved in reservation order, wait for the earlier producers */
+    if (!(fifo->flags & FIFO_FLAG_SINGLE_PRODUCER)
+            && atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire) != head) {
+        start = fifo_stats_now();
+        while (atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire) != head) {
+            /* the earlier producer may be preempted, give it the CPU instead of burning the time slice */
+            if (++spin < FIFO_COMMIT_SPIN_TIMES) {
+                fifo_cpu_relax();
+            } else {
+                fifo_platform_yield();
+            }
+        }
+        fifo_stats_commit_wait(fifo, start);
+    }
+    /* commits are serialized in ring buffer order, so the sequence number needs no atomic operation.
+     * the shards of an ordered group number their commits together, the merge follows the numbers */
+    if (seq && fifo->group && fifo->group->order == FIFO_ORDER_SEQ) {
+        value = atomic_fetch_add_explicit(&fifo->group->seq, 1, memory_order_relaxed);
+        memcpy(seq, &value, sizeof(value));
+    } else if (seq) {
+        memcpy(seq, &fifo->ring->seq, sizeof(fifo->ring->seq));
+        fifo->ring->seq++;
     }
+    if (fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) {
+        /* the unused reserved space is given back */
+        atomic_store_explicit(&fifo->ring->prod_head, head + size, memory_order_relaxed);
+    }
+    atomic_store_explicit(&fifo->ring->prod_tail, head + size, memory_order_release);
+    if (fifo->shared) {
+        fifo_platform_producer_unlock(fifo);
+    }
+}
 
-    buf_is_empty = false;
+/**
+ * the records are stamped with fifo_platform_get_ticks, they only mean time in this process.
+ * the file backed and shared memory ring buffers are read by other processes, they take nanoseconds
+ *
+ * @param fifo instance
+ *
+ * @return true when the timestamps are converted at output
+ */
+static inline bool fifo_raw_stamps(fifo_t *fifo) {
+    return !fifo->ring_path && !fifo->shm_name;
+}
 
-__exit:
+/**
+ * write a padding record, the consumer skips it
+ *
+ * @param fifo instance
+ * @param index start index of the padding
+ * @param size padding size, it includes the header
+ */
+static void async_put_pad(fifo_t *fifo, size_t index, size_t size) {
+    FifoRecHdr *hdr = (FifoRecHdr *)(fifo->buf + (index & (fifo->capacity - 1)));
 
-    return size;
+    hdr->size = size - sizeof(FifoRecHdr);
+    hdr->type = FIFO_REC_PAD;
 }
 
-void async_output_task(void *arg) {
-    size_t get_log_size = 0;
-    static char poll_get_buf[OUTPUT_BUF_SIZE - 4];
+/**
+ * reserve a whole record in framed mode, a record never wraps around the end of the storage
+ *
+ * @param fifo instance
+ * @param size payload size
+ * @param resv reserved space
+ *
+ * @return false when the ring buffer has no space for the whole record
+ */
+static bool async_reserve_record(fifo_t *fifo, size_t size, FifoResv *resv) {
+    size_t total = FIFO_REC_ALIGN(fifo->rec_hdr_size + size), pad, head, tail, offset;
+    char *hdr;
 
-    extern bool thread_running;
-    while(thread_running) {
-        /* waiting log */
-        void fifo_async_get_notice(void);
-        fifo_async_get_notice(); // block until get notice
-        /* polling gets and outputs the log */
-        while(true) {
-            extern size_t fifo_async_get_log(char *log, size_t size);
-            get_log_size = fifo_async_get_log(poll_get_buf, OUTPUT_BUF_SIZE - 4);
-
-            if (get_log_size) {
-                extern FifoCallbacks usr_cbs;
-                if(usr_cbs.fp_fifo_pop != NULL)
-                    usr_cbs.fp_fifo_pop(poll_get_buf, get_log_size);
-            } else {
-                break;
+    if (size > UINT32_MAX || total > fifo->capacity) {
+        return false;
+    }
+
+    if (fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) {
+        if (fifo->shared) {
+            fifo_platform_producer_lock(fifo);
+        }
+        head = atomic_load_explicit(&fifo->ring->prod_tail, memory_order_relaxed);
+        offset = head & (fifo->capacity - 1);
+        pad = (!fifo->buf_mirrored && offset + total > fifo->capacity) ? fifo->capacity - offset : 0;
+        if (async_get_space(fifo, head, pad + total, &tail) < pad + total) {
+            if (fifo->shared) {
+                fifo_platform_producer_unlock(fifo);
+            }
+            return false;
+        }
+        atomic_store_explicit(&fifo->ring->prod_head, head + pad + total, memory_order_relaxed);
+    } else {
+        head = atomic_load_explicit(&fifo->ring->prod_head, memory_order_relaxed);
+        do {
+            offset = head & (fifo->capacity - 1);
+            /* the tail of the storage is skipped by a padding record when the record does not fit */
+            pad = (!fifo->buf_mirrored && offset + total > fifo->capacity) ? fifo->capacity - offset : 0;
+            if (async_get_space(fifo, head, pad + total, &tail) < pad + total) {
+                return false;
             }
+        } while (!atomic_compare_exchange_weak_explicit(&fifo->ring->prod_head, &head, head + pad + total,
+                memory_order_relaxed, memory_order_relaxed));
+    }
+
+    fifo_stats_used(fifo, head + pad + total - tail);
+    if (pad) {
+        async_put_pad(fifo, head, pad);
+    }
+    resv->fifo = fifo;
+    resv->head = head;
+    resv->size = pad + total;
+    resv->rec = head + pad;
+    resv->cap = size;
+    hdr = fifo->buf + (resv->rec & (fifo->capacity - 1));
+    resv->ptr = hdr + fifo->rec_hdr_size;
+    /* stamp the record on entry, a private ring takes the raw ticks and the output thread converts them */
+    if (fifo->flags & FIFO_FLAG_TIMESTAMP) {
+        uint64_t timestamp = fifo_raw_stamps(fifo) ? fifo_platform_get_ticks() : fifo_platform_get_time();
+        memcpy(resv->ptr - sizeof(timestamp), &timestamp, sizeof(timestamp));
+    }
+
+    return true;
+}
+
+/**
+ * publish a reserved record in framed mode
+ *
+ * @param fifo instance
+ * @param resv reserved space
+ * @param size payload size, it is not larger than the reserved payload size
+ * @param type FIFO_REC_xxx
+ */
+static void async_commit_record(fifo_t *fifo, FifoResv *resv, size_t size, uint16_t type) {
+    FifoRecHdr *hdr = (FifoRecHdr *)(fifo->buf + (resv->rec & (fifo->capacity - 1)));
+    size_t end = resv->head + resv->size, rec_end = resv->rec + FIFO_REC_ALIGN(fifo->rec_hdr_size + size);
+
+    /* give the unused space back, or skip it by a padding record */
+    if (rec_end < end) {
+        if (fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) {
+            end = rec_end;
+        } else if (atomic_compare_exchange_strong_explicit(&fifo->ring->prod_head, &end, rec_end,
+                memory_order_relaxed, memory_order_relaxed)) {
+            end = rec_end;
+        } else {
+            end = resv->head + resv->size;
+            async_put_pad(fifo, rec_end, end - rec_end);
         }
     }
-    // return NULL;
+    hdr->size = size;
+    hdr->type = type;
+
+    async_commit(fifo, resv->head, end - resv->head,
+            (fifo->flags & FIFO_FLAG_SEQ) ? (char *)hdr + sizeof(FifoRecHdr) : NULL);
 }
 
 /**
- * output RAW format log
+ * space needed to reserve the data at the current reserve index
  *
- * @param format output format
- * @param ... args
+ * @param fifo instance
+ * @param size data size, the payload size in framed mode
+ *
+ * @return needed space, the padding record is included in framed mode
  */
-void fifo_push(const char *format, ...) {
-    va_list args;
-    size_t log_len = 0;
-    int fmt_result;
+static size_t async_get_need(fifo_t *fifo, size_t size) {
+    size_t total, offset;
 
-    /* check output enabled */
-    if (!s_fifo.output_enabled) {
-        return;
+    if (!(fifo->flags & FIFO_FLAG_FRAMED)) {
+        return size;
     }
+    total = FIFO_REC_ALIGN(fifo->rec_hdr_size + size);
+    offset = atomic_load_explicit((fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) ? &fifo->ring->prod_tail : &fifo->ring->prod_head,
+            memory_order_relaxed) & (fifo->capacity - 1);
 
-    /* args point to the first variable parameter */
-    va_start(args, format);
+    return (!fifo->buf_mirrored && offset + total > fifo->capacity) ? fifo->capacity - offset + total : total;
+}
 
-    /* lock output */
-    fifo_output_lock();
+/**
+ * asynchronous output ring buffer space for the next reservation
+ *
+ * @param fifo instance
+ *
+ * @return free space
+ */
+static size_t async_get_buf_space(fifo_t *fifo) {
+    /* the read index is loaded first, so it is never beyond the reserve index */
+    size_t tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_acquire);
+    size_t head = atomic_load_explicit((fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) ? &fifo->ring->prod_tail : &fifo->ring->prod_head,
+            memory_order_relaxed);
 
-    /* package log data to buffer */
-    fmt_result = vsnprintf(log_buf, FIFO_ONE_MSG_MAX_SIZE, format, args);
+    return fifo->capacity - (head - tail);
+}
 
-    /* output converted log */
-    if ((fmt_result > -1) && (fmt_result <= FIFO_ONE_MSG_MAX_SIZE)) {
-        log_len = fmt_result;
-    } else {
-        log_len = FIFO_ONE_MSG_MAX_SIZE;
+/**
+ * check the data can fit the empty ring buffer with the overflow policy which waits for space
+ *
+ * @param fifo instance
+ * @param size data size, the payload size in framed mode
+ *
+ * @return true when it fits
+ */
+static bool async_fits(fifo_t *fifo, size_t size) {
+    size_t total;
+
+    if (!(fifo->flags & FIFO_FLAG_FRAMED)) {
+        return size <= fifo->capacity;
     }
-    /* put log to buffer */
-    size_t put_size;
-    put_size = async_put_log(log_buf, log_len);
-    /* notify output log thread */
-    if (put_size > 0) {
-        /* this function must be implement by user when FIFO_ASYNC_OUTPUT_USING_PTHREAD is not defined */
-        fifo_async_put_notice();
+    if (size > UINT32_MAX) {
+        return false;
     }
+    total = FIFO_REC_ALIGN(fifo->rec_hdr_size + size);
+    /* a record may need a padding record before it, which is shorter than the record */
+    return fifo->buf_mirrored ? total <= fifo->capacity : total <= fifo->capacity / 2;
+}
 
-    /* unlock output */
-    fifo_output_unlock();
+/**
+ * discard the oldest committed data to make space for FIFO_OVERFLOW_OVERWRITE
+ * @note the read index is moved by CAS, the consumer validates its copy with CAS on the same index
+ *
+ * @param fifo instance
+ * @param size data size, the payload size in framed mode
+ * @param discarded set when some data is discarded
+ *
+ * @return false when the oldest data is not committed yet
+ */
+static bool async_overwrite(fifo_t *fifo, size_t size, bool *discarded) {
+    size_t tail, head, need, target, end, index;
+    const FifoRecHdr *hdr;
 
-    va_end(args);
+    do {
+        tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_acquire);
+        head = atomic_load_explicit((fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) ? &fifo->ring->prod_tail : &fifo->ring->prod_head,
+                memory_order_relaxed);
+        need = async_get_need(fifo, size);
+        if (fifo->capacity - (head - tail) >= need) {
+            return true;
+        }
+        target = head + need - fifo->capacity;
+        end = atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire);
+        if (target > end) {
+            return false;
+        }
+        index = target;
+        if (fifo->flags & FIFO_FLAG_FRAMED) {
+            /* discard whole records, a header may be torn by another overwriting producer, then CAS fails */
+            for (index = tail; index < target && index < end; ) {
+                hdr = (const FifoRecHdr *)(fifo->buf + (index & (fifo->capacity - 1)));
+                index += hdr->type == FIFO_REC_PAD ? sizeof(FifoRecHdr) + hdr->size
+                        : FIFO_REC_ALIGN(fifo->rec_hdr_size + hdr->size);
+            }
+            if (index > end) {
+                return false;
+            }
+        }
+    } while (!atomic_compare_exchange_strong_explicit(&fifo->ring->cons_tail, &tail, index,
+            memory_order_acq_rel, memory_order_relaxed));
+    *discarded = true;
+
+    return true;
+}
+
+/**
+ * wait for space for FIFO_OVERFLOW_BLOCK, the consumer signals after it releases space
+ *
+ * @param fifo instance
+ * @param size data size, the payload size in framed mode
+ * @param deadline wait deadline, it is set by the first wait of the push, 0: wait forever
+ *
+ * @return false on timeout
+ */
+static bool async_wait_space(fifo_t *fifo, size_t size, uint64_t *deadline) {
+    uint64_t now = 0;
+    uint32_t timeout_ms = 0;
+    bool result = true;
+
+    if (fifo->block_timeout_ns && !*deadline) {
+        *deadline = fifo_platform_get_time() + fifo->block_timeout_ns;
+    }
+
+    fifo_output_lock(fifo);
+    atomic_fetch_add_explicit(&fifo->space_waiters, 1, memory_order_relaxed);
+    /* pairs with the fence in fifo_release_h */
+    atomic_thread_fence(memory_order_seq_cst);
+    while (async_get_buf_space(fifo) < async_get_need(fifo, size)) {
+        if (*deadline) {
+            now = fifo_platform_get_time();
+            if (now >= *deadline) {
+                result = false;
+                break;
+            }
+            /* round up, so the wait never ends before the deadline */
+            timeout_ms = (uint32_t)((*deadline - now + 999999) / 1000000);
+        }
+        fifo_async_get_space_notice(fifo, timeout_ms);
+    }
+    atomic_fetch_sub_explicit(&fifo->space_waiters, 1, memory_order_relaxed);
+    fifo_output_unlock(fifo);
+
+    return result;
+}
+
+/**
+ * handle a failed reservation by the overflow policy
+ *
+ * @param fifo instance
+ * @param size data size, the payload size in framed mode
+ * @param deadline FIFO_OVERFLOW_BLOCK deadline of the push
+ * @param retries failed FIFO_OVERFLOW_OVERWRITE retries of the push
+ *
+ * @return FIFO_NO_ERR or FIFO_ERR_OVERWRITTEN: retry the reservation, others: the push result
+ */
+static FifoErrCode async_overflow(fifo_t *fifo, size_t size, uint64_t *deadline, size_t *retries) {
+    bool discarded = false;
+
+    switch (fifo->overflow) {
+    case FIFO_OVERFLOW_OVERWRITE:
+        if (async_overwrite(fifo, size, &discarded)) {
+            return discarded ? FIFO_ERR_OVERWRITTEN : FIFO_NO_ERR;
+        }
+        /* an earlier producer has not committed the oldest data, give it the CPU */
+        if (++(*retries) > FIFO_COMMIT_SPIN_TIMES) {
+            return FIFO_ERR_DROPPED;
+        }
+        fifo_platform_yield();
+        return FIFO_NO_ERR;
+    case FIFO_OVERFLOW_BLOCK:
+        if (!(fifo->flags & FIFO_FLAG_NO_THREAD)) {
+            return async_wait_space(fifo, size, deadline) ? FIFO_NO_ERR : FIFO_ERR_TIMEOUT;
+        }
+        /* nothing else frees the space, the producer drains the ring buffer itself.
+         * it gives up the CPU while another thread drains or an earlier producer has not committed */
+        if (fifo->block_timeout_ns && !*deadline) {
+            *deadline = fifo_platform_get_time() + fifo->block_timeout_ns;
+        }
+        if (!fifo_poll_h(fifo, 0)) {
+            if (*deadline && fifo_platform_get_time() >= *deadline) {
+                return FIFO_ERR_TIMEOUT;
+            }
+            fifo_platform_yield();
+        }
+        return FIFO_NO_ERR;
+    case FIFO_OVERFLOW_SPILL:
+        return FIFO_ERR_SPILLED;
+    default:
+        return FIFO_ERR_DROPPED;
+    }
+}
+
+/**
+ * append log to the spill file for FIFO_OVERFLOW_SPILL
+ *
+ * @param fifo instance
+ * @param log put log buffer
+ * @param size log size
+ *
+ * @return FIFO_ERR_SPILLED, FIFO_ERR_DROPPED when writing the file failed
+ */
+static FifoErrCode async_spill(fifo_t *fifo, const char *log, size_t size) {
+    FifoSpillHdr hdr = { 0 };
+    bool ok;
+
+    if ((fifo->flags & FIFO_FLAG_FRAMED) && size > UINT32_MAX) {
+        return FIFO_ERR_DROPPED;
+    }
+    hdr.size = (uint32_t)size;
+    if (fifo->flags & FIFO_FLAG_TIMESTAMP) {
+        hdr.timestamp = fifo_platform_get_time();
+    }
+
+    fifo_output_lock(fifo);
+    ok = fseek(fifo->spill_file, (long)fifo->spill_wpos, SEEK_SET) == 0
+            && (!(fifo->flags & FIFO_FLAG_FRAMED) || fwrite(&hdr, sizeof(hdr), 1, fifo->spill_file) == 1)
+            && fwrite(log, 1, size, fifo->spill_file) == size;
+    if (ok) {
+        /* a partly written log is overwritten by the next one */
+        fifo->spill_wpos += ((fifo->flags & FIFO_FLAG_FRAMED) ? sizeof(hdr) : 0) + size;
+        atomic_store_explicit(&fifo->spill_active, true, memory_order_release);
+    }
+    fifo_output_unlock(fifo);
+
+    return ok ? FIFO_ERR_SPILLED : FIFO_ERR_DROPPED;
+}
+
+/**
+ * reserve a whole record in framed mode, the overflow policy handles the full ring buffer
+ *
+ * @param fifo instance
+ * @param size payload size
+ * @param resv reserved space
+ *
+ * @return FIFO_NO_ERR or FIFO_ERR_OVERWRITTEN when it is reserved, others: the push result
+ */
+static FifoErrCode async_reserve_record_policy(fifo_t *fifo, size_t size, FifoResv *resv) {
+    FifoErrCode result;
+    uint64_t deadline = 0;
+    size_t retries = 0;
+    bool overwritten = false;
+
+    if (fifo->overflow != FIFO_OVERFLOW_DROP && fifo->overflow != FIFO_OVERFLOW_SPILL && !async_fits(fifo, size)) {
+        return FIFO_ERR_DROPPED;
+    }
+
+    while (!async_reserve_record(fifo, size, resv)) {
+        result = async_overflow(fifo, size, &deadline, &retries);
+        if (result == FIFO_ERR_OVERWRITTEN) {
+            overwritten = true;
+        } else if (result != FIFO_NO_ERR) {
+            return result;
+        }
+    }
+
+    return overwritten ? FIFO_ERR_OVERWRITTEN : FIFO_NO_ERR;
+}
+
+/**
+ * put log to asynchronous output ring buffer, the overflow policy handles the full ring buffer
+ *
+ * @param fifo instance
+ * @param log put log buffer
+ * @param stored log size, it is the stored size after FIFO_ERR_TRUNCATED
+ *
+ * @return result, the log is stored unless it is FIFO_ERR_DROPPED or FIFO_ERR_TIMEOUT
+ */
+static FifoErrCode async_put_log(fifo_t *fifo, const char *log, size_t *stored) {
+    FifoErrCode result;
+    FifoResv resv;
+    uint64_t deadline = 0;
+    size_t head, put, retries = 0, size = *stored;
+    bool overwritten = false;
+
+    /* an empty record is still a record, but empty data of stream mode is nothing */
+    if (!size && !(fifo->flags & FIFO_FLAG_FRAMED)) {
+        return FIFO_NO_ERR;
+    }
+
+    /* the spilled logs are output first */
+    if (fifo->overflow == FIFO_OVERFLOW_SPILL && atomic_load_explicit(&fifo->spill_active, memory_order_relaxed)) {
+        return async_spill(fifo, log, size);
+    }
+
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        result = async_reserve_record_policy(fifo, size, &resv);
+        if (result == FIFO_NO_ERR || result == FIFO_ERR_OVERWRITTEN) {
+            memcpy(resv.ptr, log, size);
+            async_commit_record(fifo, &resv, size, FIFO_REC_DATA);
+            return result;
+        }
+    } else if (fifo->overflow != FIFO_OVERFLOW_DROP && fifo->overflow != FIFO_OVERFLOW_SPILL
+            && !async_fits(fifo, size)) {
+        return FIFO_ERR_DROPPED;
+    } else {
+        for (;;) {
+            put = size;
+            /* only FIFO_OVERFLOW_DROP keeps the head of the log */
+            if (async_reserve(fifo, &put, &head, fifo->overflow != FIFO_OVERFLOW_DROP)) {
+                fifo_buf_write(fifo, head, log, put);
+                async_commit(fifo, head, put, NULL);
+                *stored = put;
+                return put < size ? FIFO_ERR_TRUNCATED : (overwritten ? FIFO_ERR_OVERWRITTEN : FIFO_NO_ERR);
+            }
+            result = async_overflow(fifo, size, &deadline, &retries);
+            if (result == FIFO_ERR_OVERWRITTEN) {
+                overwritten = true;
+            } else if (result != FIFO_NO_ERR) {
+                break;
+            }
+        }
+    }
+
+    if (result == FIFO_ERR_SPILLED) {
+        return async_spill(fifo, log, size);
+    }
+
+    return result;
+}
+
+/**
+ * parse the committed records in framed mode
+ *
+ * @param fifo instance
+ * @param base records storage
+ * @param mask index mask of the storage
+ * @param index free running index of the first record header
+ * @param end commit index
+ * @param records parsed records
+ * @param ends index after each record, NULL: not needed
+ * @param count parsed records count
+ *
+ * @return index after the parsed records, it is at a record boundary
+ */
+static size_t fifo_parse_records(fifo_t *fifo, const char *base, size_t mask, size_t index, size_t end,
+        FifoRecord *records, size_t *ends, size_t *count) {
+    const FifoRecHdr *hdr;
+    const char *stamp;
+    size_t total, fmt_used = 0, fmt_size, i;
+
+    *count = 0;
+    while (index < end && *count < FIFO_POP_RECORDS_MAX) {
+        /* a record never wraps around the end of the storage */
+        hdr = (const FifoRecHdr *)(base + (index & mask));
+        total = hdr->type == FIFO_REC_PAD ? sizeof(FifoRecHdr) + hdr->size
+                : FIFO_REC_ALIGN(fifo->rec_hdr_size + hdr->size);
+        /* a copied record may be cut at the end of the copy */
+        if (total > end - index) {
+            break;
+        }
+        if (hdr->type == FIFO_REC_PAD) {
+            index += total;
+            continue;
+        }
+        stamp = (const char *)hdr + sizeof(FifoRecHdr);
+        records[*count].offset = index;
+        records[*count].seq = 0;
+        records[*count].timestamp = 0;
+        if (fifo->flags & FIFO_FLAG_SEQ) {
+            memcpy(&records[*count].seq, stamp, sizeof(uint64_t));
+            stamp += sizeof(uint64_t);
+        }
+        if (fifo->flags & FIFO_FLAG_TIMESTAMP) {
+            memcpy(&records[*count].timestamp, stamp, sizeof(uint64_t));
+        }
+        records[*count].data = (const char *)hdr + fifo->rec_hdr_size;
+        records[*count].size = hdr->size;
+        if (hdr->type == FIFO_REC_DEFERRED) {
+            /* the batch ends when the format buffer may not hold the next one */
+            fmt_size = FIFO_FMT_BUF_SIZE - fmt_used;
+            if (fmt_size < FIFO_ONE_MSG_MAX_SIZE && *count) {
+                break;
+            }
+            if (!fifo->fmt_buf && !(fifo->fmt_buf = malloc(FIFO_FMT_BUF_SIZE))) {
+                records[*count].size = 0;
+            } else {
+                records[*count].size = fifo_fmt_expand(records[*count].data, hdr->size, fifo->fmt_buf + fmt_used,
+                        fmt_size < FIFO_ONE_MSG_MAX_SIZE ? fmt_size : FIFO_ONE_MSG_MAX_SIZE);
+                records[*count].data = fifo->fmt_buf + fmt_used;
+                fmt_used += records[*count].size;
+            }
+        }
+        index += total;
+        if (ends) {
+            ends[*count] = index;
+        }
+        (*count)++;
+    }
+    /* the ticks of the batch are converted together, off the producer path */
+    if ((fifo->flags & FIFO_FLAG_TIMESTAMP) && fifo_raw_stamps(fifo)) {
+        for (i = 0; i < *count; i++) {
+            records[i].timestamp = fifo_platform_ticks_to_ns(records[i].timestamp);
+        }
+    }
+
+    return index;
+}
+
+/**
+ * the data is in the ring buffer storage
+ *
+ * @param fifo instance
+ * @param ptr data
+ *
+ * @return false when it is in a buffer of the output thread
+ */
+static bool fifo_in_ring(fifo_t *fifo, const void *ptr) {
+    const char *data = ptr;
+
+    return data >= fifo->buf && data < fifo->buf + (fifo->buf_mirrored ? fifo->capacity * 2 : fifo->capacity);
+}
+
+/**
+ * pass the records of framed mode to the sink or the callbacks
+ *
+ * @param fifo instance
+ * @param records records
+ * @param count records count, it is not larger than FIFO_POP_RECORDS_MAX
+ * @param release ring buffer space of the records, the sink releases it
+ */
+static void fifo_pop_records(fifo_t *fifo, const FifoRecord *records, size_t count, size_t release) {
+    struct iovec iov[FIFO_POP_RECORDS_MAX];
+    bool in_ring = true;
+    size_t i;
+
+    fifo_stats_latency(fifo, records, count);
+    if (fifo->sink) {
+        for (i = 0; i < count; i++) {
+            iov[i].iov_base = (void *)records[i].data;
+            iov[i].iov_len = records[i].size;
+            /* the deferred records are formatted into the format buffer */
+            in_ring = in_ring && (!records[i].size || fifo_in_ring(fifo, records[i].data));
+        }
+        fifo->sink->write(fifo->sink, fifo, iov, (int)count, release, in_ring);
+    } else if (!count) {
+        /* only padding */
+    } else if (fifo->cbs.fp_fifo_pop_iov != NULL) {
+        for (i = 0; i < count; i++) {
+            iov[i].iov_base = (void *)records[i].data;
+            iov[i].iov_len = records[i].size;
+        }
+        fifo->cbs.fp_fifo_pop_iov(iov, (int)count);
+    } else if (fifo->cbs.fp_fifo_pop_records != NULL) {
+        fifo->cbs.fp_fifo_pop_records(records, count);
+    } else if (fifo->cbs.fp_fifo_pop != NULL) {
+        for (i = 0; i < count; i++) {
+            fifo->cbs.fp_fifo_pop(records[i].data, records[i].size);
+        }
+    }
+}
+
+/**
+ * pass the data of stream mode to the sink or the callbacks
+ *
+ * @param fifo instance
+ * @param iov data regions
+ * @param count regions count
+ * @param release ring buffer space of the data, the sink releases it
+ */
+static void fifo_pop_stream(fifo_t *fifo, const struct iovec *iov, size_t count, size_t release) {
+    size_t i;
+
+    if (fifo->sink) {
+        fifo->sink->write(fifo->sink, fifo, iov, (int)count, release, count && fifo_in_ring(fifo, iov[0].iov_base));
+    } else if (fifo->cbs.fp_fifo_pop_iov != NULL) {
+        fifo->cbs.fp_fifo_pop_iov(iov, (int)count);
+    } else if (fifo->cbs.fp_fifo_pop != NULL) {
+        for (i = 0; i < count; i++) {
+            fifo->cbs.fp_fifo_pop(iov[i].iov_base, iov[i].iov_len);
+        }
+    }
+}
+
+/**
+ * output a batch of the committed data for FIFO_OVERFLOW_OVERWRITE, the data is copied out first.
+ * the copy is valid when no producer has moved the read index during copying, the read index is
+ * moved by CAS as the validation, an overwritten copy is taken again.
+ *
+ * @param fifo instance
+ *
+ * @return output size, 0 means ring buffer is empty
+ */
+static size_t fifo_async_output_copy(fifo_t *fifo) {
+    FifoRecord records[FIFO_POP_RECORDS_MAX];
+    struct iovec iov;
+    size_t tail, end, size, count, i;
+
+    /* a failed validation outputs nothing, so it is retried here instead of counted by the drain loops */
+    do {
+        tail = atomic_load_explicit(&fifo->ring->cons_tail, memory_order_acquire);
+        end = atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire);
+        if (tail == end) {
+            return 0;
+        }
+
+        fifo_buf_read(fifo, tail, fifo->copy_buf, end - tail);
+        if (fifo->flags & FIFO_FLAG_FRAMED) {
+            size = fifo_parse_records(fifo, fifo->copy_buf, SIZE_MAX, 0, end - tail, records, NULL, &count);
+            /* the copy starts at the read index */
+            for (i = 0; i < count; i++) {
+                records[i].offset += tail;
+            }
+        } else {
+            size = end - tail;
+        }
+    } while (!atomic_compare_exchange_strong_explicit(&fifo->ring->cons_tail, &tail, tail + size,
+            memory_order_acq_rel, memory_order_relaxed));
+    fifo->cons_head = tail + size;
+
+    /* the space is released by the validation */
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        fifo_pop_records(fifo, records, count, 0);
+    } else {
+        iov.iov_base = fifo->copy_buf;
+        iov.iov_len = size;
+        fifo_pop_stream(fifo, &iov, 1, 0);
+    }
+
+    return size;
+}
+
+/**
+ * output the next run of a merged group. with FIFO_ORDER_SEQ every shard is in sequence number order, so the
+ * next number is at the head of one shard, the run goes on while that shard holds the following numbers.
+ * with FIFO_ORDER_TIME the shard with the oldest head is output until a record is newer than the other heads.
+ *
+ * @param fifo the first shard, its output thread merges the group
+ *
+ * @return output size, 0 means all shards are empty
+ */
+static size_t fifo_async_output_merge(fifo_t *fifo) {
+    struct fifo_group *group = fifo->group;
+    bool by_seq = group->order == FIFO_ORDER_SEQ;
+    FifoMergeBatch *batch;
+    fifo_t *shard;
+    size_t i, pos, tail, end, index, best;
+    uint64_t key, best_key, limit;
+    bool pending;
+
+    /* a producer takes the next number just before it publishes its commit, the head shows up at once.
+     * it is waited for here, the drain loops only count the real output */
+    for (;;) {
+        best = group->count;
+        best_key = limit = UINT64_MAX;
+        pending = false;
+        for (i = 0; i < group->count; i++) {
+            shard = group->shards[i];
+            batch = &group->batches[i];
+            tail = shard->cons_head;
+            if (batch->pos == batch->count) {
+                end = atomic_load_explicit(&shard->ring->prod_tail, memory_order_acquire);
+                if (tail == end) {
+                    continue;
+                }
+                batch->end = fifo_parse_records(shard, shard->buf, shard->capacity - 1, tail, end, batch->records,
+                        batch->ends, &batch->count);
+                batch->pos = 0;
+                if (!batch->count) {
+                    /* only padding */
+                    fifo_pop_records(shard, batch->records, 0, batch->end - tail);
+                    shard->cons_head = batch->end;
+                    if (!shard->sink) {
+                        fifo_release_h(shard, batch->end - tail);
+                    }
+                    return batch->end - tail;
+                }
+            }
+            pending = true;
+            if (by_seq) {
+                if (batch->records[batch->pos].seq == group->next_seq) {
+                    best = i;
+                    break;
+                }
+                continue;
+            }
+            /* the oldest head is output, the second oldest ends its run */
+            key = batch->records[batch->pos].timestamp;
+            if (key < best_key) {
+                limit = best_key;
+                best_key = key;
+                best = i;
+            } else if (key < limit) {
+                limit = key;
+            }
+        }
+        if (best != group->count) {
+            break;
+        }
+        if (!pending) {
+            return 0;
+        }
+        fifo_platform_yield();
+    }
+
+    shard = group->shards[best];
+    batch = &group->batches[best];
+    tail = shard->cons_head;
+    for (pos = batch->pos; pos < batch->count; pos++) {
+        if (by_seq ? batch->records[pos].seq != group->next_seq : batch->records[pos].timestamp > limit) {
+            break;
+        }
+        group->next_seq++;
+    }
+    index = pos == batch->count ? batch->end : batch->ends[pos - 1];
+    fifo_pop_records(shard, batch->records + batch->pos, pos - batch->pos, index - tail);
+    batch->pos = pos;
+    shard->cons_head = index;
+    if (!shard->sink) {
+        fifo_release_h(shard, index - tail);
+    }
+
+    return index - tail;
+}
+
+/**
+ * output a batch of the committed data, fp_fifo_pop_iov gets it with one call
+ *
+ * @param fifo instance
+ *
+ * @return output size, 0 means ring buffer is empty
+ */
+static size_t fifo_async_output(fifo_t *fifo) {
+    struct iovec iov[2];
+    FifoRecord records[FIFO_POP_RECORDS_MAX];
+    size_t tail, end, index, offset, count;
+
+    if (fifo->overflow == FIFO_OVERFLOW_OVERWRITE) {
+        return fifo_async_output_copy(fifo);
+    }
+    if (fifo_is_merger(fifo)) {
+        return fifo_async_output_merge(fifo);
+    }
+
+    /* the sink may hold the space before the output index */
+    tail = fifo->cons_head;
+    end = atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire);
+    if (tail == end) {
+        return 0;
+    }
+
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        index = fifo_parse_records(fifo, fifo->buf, fifo->capacity - 1, tail, end, records, NULL, &count);
+        fifo_pop_records(fifo, records, count, index - tail);
+    } else {
+        index = end;
+        offset = tail & (fifo->capacity - 1);
+        iov[0].iov_base = fifo->buf + offset;
+        iov[0].iov_len = end - tail;
+        count = 1;
+        /* the mirrored storage is contiguous across the end */
+        if (!fifo->buf_mirrored && offset + (end - tail) > fifo->capacity) {
+            iov[0].iov_len = fifo->capacity - offset;
+            iov[1].iov_base = fifo->buf;
+            iov[1].iov_len = (end - tail) - iov[0].iov_len;
+            count = 2;
+        }
+        fifo_pop_stream(fifo, iov, count, index - tail);
+    }
+
+    fifo->cons_head = index;
+    if (!fifo->sink) {
+        fifo_release_h(fifo, index - tail);
+    }
+
+    return index - tail;
+}
+
+/**
+ * replay the spill file of FIFO_OVERFLOW_SPILL, a record or a chunk at a time.
+ * it is called when the ring buffer is empty, the spill mode ends after the file is replayed.
+ *
+ * @param fifo instance
+ *
+ * @return output size, 0 means the spill file is replayed
+ */
+static size_t fifo_async_output_spill(fifo_t *fifo) {
+    FifoRecord record = { 0 };
+    FifoSpillHdr hdr;
+    struct iovec iov;
+    size_t size = 0, hdr_size = 0;
+    char *buf;
+    bool ok;
+
+    if (!fifo->spill_file || !atomic_load_explicit(&fifo->spill_active, memory_order_acquire)) {
+        return 0;
+    }
+
+    fifo_output_lock(fifo);
+    ok = fifo->spill_rpos < fifo->spill_wpos
+            && fseek(fifo->spill_file, (long)fifo->spill_rpos, SEEK_SET) == 0;
+    if (ok) {
+        if (fifo->flags & FIFO_FLAG_FRAMED) {
+            hdr_size = sizeof(hdr);
+            ok = fread(&hdr, sizeof(hdr), 1, fifo->spill_file) == 1;
+            size = hdr.size;
+        } else {
+            size = fifo->spill_wpos - fifo->spill_rpos;
+            size = size < FIFO_SPILL_CHUNK_SIZE ? size : FIFO_SPILL_CHUNK_SIZE;
+        }
+    }
+    if (ok && size > fifo->spill_buf_size) {
+        buf = realloc(fifo->spill_buf, size);
+        ok = buf != NULL;
+        if (ok) {
+            fifo->spill_buf = buf;
+            fifo->spill_buf_size = size;
+        }
+    }
+    ok = ok && fread(fifo->spill_buf, 1, size, fifo->spill_file) == size;
+    if (ok) {
+        fifo->spill_rpos += hdr_size + size;
+    } else {
+        /* replayed, or the rest can not be read. the file is written from the start again */
+        fifo->spill_rpos = fifo->spill_wpos = 0;
+        atomic_store_explicit(&fifo->spill_active, false, memory_order_relaxed);
+    }
+    fifo_output_unlock(fifo);
+
+    if (!ok) {
+        return 0;
+    }
+    /* spilled records carry no sequence number */
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        record.data = fifo->spill_buf;
+        record.size = size;
+        record.timestamp = hdr.timestamp;
+        fifo_pop_records(fifo, &record, 1, 0);
+    } else {
+        iov.iov_base = fifo->spill_buf;
+        iov.iov_len = size;
+        fifo_pop_stream(fifo, &iov, 1, 0);
+    }
+
+    /* an empty record is still output */
+    return hdr_size + size;
+}
+
+/**
+ * notify the output thread after a commit, only a parked output thread is signaled
+ *
+ * @param fifo instance
+ */
+static void fifo_async_notify(fifo_t *fifo) {
+    /* pairs with the fence in fifo_async_wait, either the commit or the parked flag is seen */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&fifo->ring->consumer_parked, memory_order_relaxed)
+            && atomic_exchange_explicit(&fifo->ring->consumer_parked, false, memory_order_relaxed)) {
+        /* the merging thread parks on the notice of the first shard, a shared memory producer posts its own */
+        fifo_notice_put(fifo_drainer(fifo));
+    }
+    if (fifo->high_water && fifo_async_get_buf_used(fifo) >= fifo->high_water) {
+        fifo_poll_h(fifo, 0);
+    }
+}
+
+/**
+ * set the parked flag of the rings the output thread drains, every shard of a merged group has one
+ *
+ * @param fifo instance
+ * @param parked new state
+ *
+ * @return false when a producer has cleared a flag first, its notice is posted
+ */
+static bool fifo_async_set_parked(fifo_t *fifo, bool parked) {
+    fifo_t *const *shards = &fifo;
+    size_t i, count = 1;
+    bool own = true;
+
+    if (fifo_is_merger(fifo)) {
+        shards = fifo->group->shards;
+        count = fifo->group->count;
+    }
+    for (i = 0; i < count; i++) {
+        if (parked) {
+            atomic_store_explicit(&shards[i]->ring->consumer_parked, true, memory_order_relaxed);
+        } else if (!atomic_exchange_explicit(&shards[i]->ring->consumer_parked, false, memory_order_relaxed)) {
+            own = false;
+        }
+    }
+
+    return own;
+}
+
+/**
+ * wait for the committed data, spin for the configured time before parking the output thread
+ *
+ * @param fifo instance
+ */
+static void fifo_async_wait(fifo_t *fifo) {
+    uint64_t deadline;
+    uint32_t hold_ms = 0;
+    size_t spin = 0;
+
+    if (fifo->spin_ns) {
+        deadline = fifo_platform_get_time() + fifo->spin_ns;
+        while (!fifo_async_get_pending(fifo)) {
+            fifo_cpu_relax();
+            /* the clock is read once every spin round */
+            if (++spin % FIFO_COMMIT_SPIN_TIMES == 0 && fifo_platform_get_time() >= deadline) {
+                break;
+            }
+        }
+        if (fifo_async_get_pending(fifo)) {
+            return;
+        }
+    }
+
+    /* the space held by the sink is released before parking, producers may wait for it.
+     * the sink may keep some output back, the thread wakes up for it in time */
+    if (fifo->sink && fifo->sink->flush) {
+        hold_ms = fifo->sink->flush(fifo->sink, fifo, true);
+    }
+    fifo_async_set_parked(fifo, true);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (fifo_async_get_pending(fifo) && fifo_async_set_parked(fifo, false)) {
+        /* data arrived before parking, no producer has signaled */
+        return;
+    }
+    if (!fifo_notice_wait(fifo, hold_ms)) {
+        /* flush the sink again, a notice posted meanwhile only wakes the next parking early */
+        fifo_async_set_parked(fifo, false);
+        return;
+    }
+    if (fifo_is_merger(fifo)) {
+        /* one shard has signaled, the others stop signaling too */
+        fifo_async_set_parked(fifo, false);
+    }
+    fifo_stats_wakeup(fifo);
+}
+
+/**
+ * output thread of the instance, the port creates it
+ *
+ * @param arg instance
+ */
+void async_output_task(void *arg) {
+    fifo_t *fifo = arg;
+
+    while(fifo->thread_running) {
+        /* waiting log */
+        fifo_async_wait(fifo);
+        /* polling outputs the log straight from the ring buffer, one batch for each callback.
+         * the spilled log is replayed when the ring buffer is empty */
+        while (fifo_async_output(fifo) || fifo_async_output_spill(fifo));
+    }
+    if (fifo->sink && fifo->sink->flush) {
+        fifo->sink->flush(fifo->sink, fifo, false);
+    }
+}
+
+/**
+ * drain an instance created with FIFO_FLAG_NO_THREAD on the calling thread, the log goes to the callbacks
+ * or the sink like on an output thread. a merged group is drained through any of its shards.
+ * one thread drains at a time, a call made while another thread drains returns 0 at once.
+ * @note with FIFO_NOTIFY_EVENTFD the fd of fifo_get_fd_h is readable while log is left after the call
+ *
+ * @param fifo instance
+ * @param max_bytes stop once this much is output, a batch is not split. 0: until it is empty
+ *
+ * @return output size
+ */
+size_t fifo_poll_h(fifo_t *fifo, size_t max_bytes) {
+    size_t size, total = 0;
+    bool parking;
+
+    if (!fifo || !(fifo->flags & FIFO_FLAG_NO_THREAD)) {
+        return 0;
+    }
+    fifo = fifo_drainer(fifo);
+    if (atomic_exchange_explicit(&fifo->polling, true, memory_order_acquire)) {
+        return 0;
+    }
+
+    /* it only parks for an event loop, otherwise a push never makes a system call */
+    parking = atomic_load_explicit(&fifo->notice_armed, memory_order_relaxed);
+    if (parking) {
+        fifo_notice_clear(fifo);
+        fifo_async_set_parked(fifo, false);
+    }
+    for (;;) {
+        while ((!max_bytes || total < max_bytes)
+                && ((size = fifo_async_output(fifo)) || (size = fifo_async_output_spill(fifo)))) {
+            total += size;
+        }
+        if (fifo_async_get_pending(fifo)) {
+            /* stopped by max_bytes, the fd stays readable */
+            if (parking) {
+                fifo_notice_put(fifo);
+            }
+            break;
+        }
+        /* the space held by the sink is released, producers may wait for it */
+        if (fifo->sink && fifo->sink->flush) {
+            fifo->sink->flush(fifo->sink, fifo, true);
+        }
+        if (!parking) {
+            break;
+        }
+        /* the next commit posts the notice, unless it came before parking */
+        fifo_async_set_parked(fifo, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!fifo_async_get_pending(fifo) || !fifo_async_set_parked(fifo, false)) {
+            break;
+        }
+    }
+    atomic_store_explicit(&fifo->polling, false, memory_order_release);
+
+    return total;
+}
+
+/**
+ * drain the default instance, see fifo_poll_h
+ *
+ * @param max_bytes stop once this much is output, 0: until it is empty
+ *
+ * @return output size
+ */
+size_t fifo_poll(size_t max_bytes) {
+    return fifo_poll_h(s_fifo, max_bytes);
+}
+
+/**
+ * pollable fd of an instance created with FIFO_FLAG_NO_THREAD, an eventfd with FIFO_NOTIFY_EVENTFD.
+ * it is readable after the first call, and when log is committed after fifo_poll_h has left the ring buffer
+ * empty. the event loop then calls fifo_drain_nonblocking_h. a push only writes it on that edge.
+ *
+ * @param fifo instance
+ *
+ * @return fd, -1 when the instance or the notifier has none
+ */
+int fifo_get_fd_h(fifo_t *fifo) {
+    int fd;
+
+    if (!fifo || !(fifo->flags & FIFO_FLAG_NO_THREAD)) {
+        return -1;
+    }
+    fifo = fifo_drainer(fifo);
+    fd = fifo_notice_fd(fifo);
+    /* the notice of the log committed so far */
+    if (fd >= 0 && !atomic_exchange_explicit(&fifo->notice_armed, true, memory_order_relaxed)) {
+        fifo_notice_put(fifo);
+    }
+
+    return fd;
+}
+
+/**
+ * pollable fd of the default instance, see fifo_get_fd_h
+ *
+ * @return fd, -1 when there is none
+ */
+int fifo_get_fd(void) {
+    return fifo_get_fd_h(s_fifo);
+}
+
+/**
+ * event handler of the fd of fifo_get_fd_h, it never waits. it outputs about one ring buffer capacity,
+ * so a busy instance does not hold the other events of the loop back. the fd stays readable while log is left
+ *
+ * @param fifo instance
+ *
+ * @return output size
+ */
+size_t fifo_drain_nonblocking_h(fifo_t *fifo) {
+    if (!fifo || !(fifo->flags & FIFO_FLAG_NO_THREAD)) {
+        return 0;
+    }
+
+    return fifo_poll_h(fifo, fifo->capacity);
+}
+
+/**
+ * event handler of the fd of fifo_get_fd, see fifo_drain_nonblocking_h
+ *
+ * @return output size
+ */
+size_t fifo_drain_nonblocking(void) {
+    return fifo_drain_nonblocking_h(s_fifo);
+}
+
+/**
+ * count the push and notify the output thread for the stored push
+ *
+ * @param fifo instance
+ * @param result push result
+ * @param size push size
+ * @param start push start time for the statistics, 0: no duration
+ */
+static void async_put_done(fifo_t *fifo, FifoErrCode result, size_t size, uint64_t start) {
+    fifo_stats_push(fifo, result, size, start);
+    switch (result) {
+    case FIFO_ERR_DROPPED:
+    case FIFO_ERR_TIMEOUT:
+        atomic_fetch_add_explicit(&fifo->dropped, 1, memory_order_relaxed);
+        break;
+    case FIFO_ERR_TRUNCATED:
+        atomic_fetch_add_explicit(&fifo->dropped, 1, memory_order_relaxed);
+        fifo_async_notify(fifo);
+        break;
+    default:
+        fifo_async_notify(fifo);
+        break;
+    }
+}
+
+/**
+ * output RAW format log to the instance
+ *
+ * @param fifo instance
+ * @param format output format
+ * @param args args
+ *
+ * @return result, see fifo_push
+ */
+FifoErrCode fifo_vpush_h(fifo_t *fifo, const char *format, va_list args) {
+    FifoErrCode result;
+    uint64_t start = fifo_stats_now();
+    size_t log_len = 0;
+    int fmt_result;
+
+    /* check output enabled */
+    if (!fifo || !fifo->output_enabled) {
+        return FIFO_ERR_DISABLED;
+    }
+
+    /* package log data to the thread local buffer, no shared state is touched */
+    fmt_result = vsnprintf(log_buf, FIFO_ONE_MSG_MAX_SIZE, format, args);
+
+    /* output converted log */
+    if ((fmt_result > -1) && (fmt_result < FIFO_ONE_MSG_MAX_SIZE)) {
+        log_len = fmt_result;
+    } else {
+        /* the log is truncated, drop the string terminator */
+        log_len = FIFO_ONE_MSG_MAX_SIZE - 1;
+    }
+    /* put log to buffer, it is the only step which touches the ring buffer */
+    result = async_put_log(fifo, log_buf, &log_len);
+    /* the cut log is reported before the stored ones, like async_put_log does */
+    if ((result == FIFO_NO_ERR || result == FIFO_ERR_OVERWRITTEN || result == FIFO_ERR_SPILLED)
+            && log_len != (size_t)fmt_result) {
+        result = FIFO_ERR_TRUNCATED;
+    }
+    /* notify output log thread */
+    async_put_done(fifo, result, log_len, start);
+
+    return result;
+}
+
+/**
+ * output RAW format log to the instance
+ *
+ * @param fifo instance
+ * @param format output format
+ * @param ... args
+ *
+ * @return result, see fifo_push
+ */
+FifoErrCode fifo_push_h(fifo_t *fifo, const char *format, ...) {
+    FifoErrCode result;
+    va_list args;
+
+    /* args point to the first variable parameter */
+    va_start(args, format);
+    result = fifo_vpush_h(fifo, format, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ * output RAW format log to the default instance
+ *
+ * @param format output format
+ * @param ... args
+ *
+ * @return result. FIFO_ERR_TRUNCATED when only the head of the log is stored, it is reported instead of
+ *         FIFO_ERR_OVERWRITTEN or FIFO_ERR_SPILLED when the cut log also overwrote the oldest or was spilled
+ */
+FifoErrCode fifo_push(const char *format, ...) {
+    FifoErrCode result;
+    va_list args;
+
+    /* args point to the first variable parameter */
+    va_start(args, format);
+    result = fifo_vpush_h(s_fifo, format, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ * deferred formatting push, see fifo_dpush_h
+ *
+ * @param fifo instance
+ * @param format output format
+ * @param types argument types, FifoArgType
+ * @param count arguments count
+ * @param args args
+ *
+ * @return result
+ */
+static FifoErrCode fifo_vdpush_h(fifo_t *fifo, const char *format, const uint8_t *types, size_t count,
+        va_list args) {
+    FifoErrCode result;
+    FifoResv resv;
+    uint64_t start = fifo_stats_now();
+    va_list args_copy;
+    size_t size;
+
+    /* check output enabled */
+    if (!fifo || !fifo->output_enabled) {
+        return FIFO_ERR_DISABLED;
+    }
+    /* stream mode has no record type, the spill file has the formatted log,
+     * and the format string of a shared memory producer is not in the collector memory,
+     * nor is the one of a file-backed ring buffer in the process which recovers it */
+    if (!(fifo->flags & FIFO_FLAG_FRAMED) || fifo->shared || fifo->ring_path || count > FIFO_DPUSH_ARGS_MAX
+            || (fifo->overflow == FIFO_OVERFLOW_SPILL && atomic_load_explicit(&fifo->spill_active, memory_order_relaxed))) {
+        return fifo_vpush_h(fifo, format, args);
+    }
+
+    va_copy(args_copy, args);
+    size = fifo_fmt_size(count, types, args_copy);
+    va_end(args_copy);
+
+    /* only the raw arguments are copied, no formatting on the caller thread */
+    result = async_reserve_record_policy(fifo, size, &resv);
+    if (result == FIFO_NO_ERR || result == FIFO_ERR_OVERWRITTEN) {
+        fifo_fmt_pack(resv.ptr, format, count, types, args);
+        async_commit_record(fifo, &resv, size, FIFO_REC_DEFERRED);
+    } else if (result == FIFO_ERR_SPILLED) {
+        return fifo_vpush_h(fifo, format, args);
+    }
+    async_put_done(fifo, result, size, start);
+
+    return result;
+}
+
+/**
+ * deferred formatting push to the instance, it is called by fifo_dpush_h
+ *
+ * @param fifo instance
+ * @param format output format
+ * @param types argument types, FifoArgType
+ * @param count arguments count
+ * @param ... args
+ *
+ * @return result
+ */
+FifoErrCode fifo_dpush_args_h(fifo_t *fifo, const char *format, const uint8_t *types, size_t count, ...) {
+    FifoErrCode result;
+    va_list args;
+
+    va_start(args, count);
+    result = fifo_vdpush_h(fifo, format, types, count, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ * deferred formatting push to the default instance, it is called by fifo_dpush
+ *
+ * @param format output format
+ * @param types argument types, FifoArgType
+ * @param count arguments count
+ * @param ... args
+ *
+ * @return result
+ */
+FifoErrCode fifo_dpush_args(const char *format, const uint8_t *types, size_t count, ...) {
+    FifoErrCode result;
+    va_list args;
+
+    va_start(args, count);
+    result = fifo_vdpush_h(s_fifo, format, types, count, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ * output RAW data without formatting to the instance
+ *
+ * @param fifo instance
+ * @param buf data buffer
+ * @param size data size
+ *
+ * @return result, see fifo_push
+ */
+FifoErrCode fifo_write_h(fifo_t *fifo, const char *buf, size_t size) {
+    FifoErrCode result;
+    uint64_t start = fifo_stats_now();
+
+    /* check output enabled */
+    if (!fifo || !fifo->output_enabled) {
+        return FIFO_ERR_DISABLED;
+    }
+
+    /* put data to buffer and notify output log thread */
+    result = async_put_log(fifo, buf, &size);
+    async_put_done(fifo, result, size, start);
+
+    return result;
+}
+
+/**
+ * output RAW data without formatting to the default instance
+ *
+ * @param buf data buffer
+ * @param size data size
+ *
+ * @return result
+ */
+FifoErrCode fifo_write(const char *buf, size_t size) {
+    return fifo_write_h(s_fifo, buf, size);
+}
+
+/**
+ * reserve space for the caller to write data in place, the data is published by fifo_commit_h
+ * @note every thread can hold one reservation at a time. Keep it short, the later producers
+ *       wait for it before their data is published.
+ *
+ * @param fifo instance
+ * @param size reserved size
+ *
+ * @return space to write, NULL when the ring buffer is full by the overflow policy or output is disabled
+ */
+void *fifo_reserve_h(fifo_t *fifo, size_t size) {
+    FifoErrCode result;
+    uint64_t deadline = 0;
+    size_t head, offset, put, retries = 0;
+
+    /* check output enabled */
+    if (!fifo || !fifo->output_enabled || !size || s_resv.fifo) {
+        return NULL;
+    }
+    /* a wrapped space is staged in the thread local buffer, it must fit there */
+    if (!(fifo->flags & FIFO_FLAG_FRAMED) && !fifo->buf_mirrored && size > FIFO_ONE_MSG_MAX_SIZE) {
+        return NULL;
+    }
+
+    /* the space is not spilled, FIFO_OVERFLOW_SPILL drops the reservation like FIFO_OVERFLOW_DROP */
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        /* a record never wraps, it is written in place */
+        result = async_reserve_record_policy(fifo, size, &s_resv);
+        if (result == FIFO_NO_ERR || result == FIFO_ERR_OVERWRITTEN) {
+            return s_resv.ptr;
+        }
+        async_put_done(fifo, result == FIFO_ERR_SPILLED ? FIFO_ERR_DROPPED : result, size, 0);
+        return NULL;
+    }
+    if ((fifo->overflow == FIFO_OVERFLOW_OVERWRITE || fifo->overflow == FIFO_OVERFLOW_BLOCK) && !async_fits(fifo, size)) {
+        return NULL;
+    }
+    for (;;) {
+        put = size;
+        if (async_reserve(fifo, &put, &head, true)) {
+            break;
+        }
+        result = async_overflow(fifo, size, &deadline, &retries);
+        if (result != FIFO_NO_ERR && result != FIFO_ERR_OVERWRITTEN) {
+            async_put_done(fifo, result == FIFO_ERR_SPILLED ? FIFO_ERR_DROPPED : result, size, 0);
+            return NULL;
+        }
+    }
+
+    s_resv.fifo = fifo;
+    s_resv.head = head;
+    s_resv.size = size;
+    s_resv.cap = size;
+    offset = head & (fifo->capacity - 1);
+    if (fifo->buf_mirrored || offset + size <= fifo->capacity) {
+        s_resv.ptr = fifo->buf + offset;
+    } else {
+        s_resv.ptr = resv_buf;
+    }
+
+    return s_resv.ptr;
+}
+
+/**
+ * publish the data written to the reserved space
+ * @note the unused space is given back when no later reservation exists, otherwise it is skipped by
+ *       a padding record in framed mode. the stream mode has no padding, the commit fails with
+ *       FIFO_ERR_BUSY then and the reservation stays held, it is committed with the reserved size
+ *
+ * @param fifo instance
+ * @param size used size, it is not larger than the reserved size, 0 cancels the reservation
+ *             in stream mode and publishes an empty record in framed mode
+ *
+ * @return result, FIFO_ERR_INVALID when the thread holds no reservation of the instance
+ */
+FifoErrCode fifo_commit_h(fifo_t *fifo, size_t size) {
+    size_t end;
+
+    if (!fifo || s_resv.fifo != fifo) {
+        return FIFO_ERR_INVALID;
+    }
+    if (size > s_resv.cap) {
+        size = s_resv.cap;
+    }
+
+    if (fifo->flags & FIFO_FLAG_FRAMED) {
+        async_commit_record(fifo, &s_resv, size, FIFO_REC_DATA);
+        s_resv.fifo = NULL;
+        fifo_stats_push(fifo, FIFO_NO_ERR, size, 0);
+        fifo_async_notify(fifo);
+        return FIFO_NO_ERR;
+    }
+
+    end = s_resv.head + s_resv.size;
+    if (size < s_resv.size) {
+        if (fifo->flags & FIFO_FLAG_SINGLE_PRODUCER) {
+            /* the single producer moves the reserve index back on commit */
+            end = s_resv.head + size;
+        } else if (atomic_compare_exchange_strong_explicit(&fifo->ring->prod_head, &end, s_resv.head + size,
+                memory_order_relaxed, memory_order_relaxed)) {
+            end = s_resv.head + size;
+        } else {
+            /* filling the rest would give the consumer bytes the producer never wrote */
+            return FIFO_ERR_BUSY;
+        }
+    }
+    if (s_resv.ptr == resv_buf) {
+        fifo_buf_write(fifo, s_resv.head, resv_buf, size);
+    }
+
+    async_commit(fifo, s_resv.head, end - s_resv.head, NULL);
+    s_resv.fifo = NULL;
+
+    if (size) {
+        fifo_stats_push(fifo, FIFO_NO_ERR, size, 0);
+        fifo_async_notify(fifo);
+    }
+
+    return FIFO_NO_ERR;
+}
+
+/**
+ * reserve space in the default instance
+ *
+ * @param size reserved size
+ *
+ * @return space to write, NULL when the ring buffer is full or output is disabled
+ */
+void *fifo_reserve(size_t size) {
+    return fifo_reserve_h(s_fifo, size);
+}
+
+/**
+ * publish the data written to the reserved space of the default instance, see fifo_commit_h
+ *
+ * @param size used size
+ *
+ * @return result
+ */
+FifoErrCode fifo_commit(size_t size) {
+    return fifo_commit_h(s_fifo, size);
+}
+
+/**
+ * committed data of the default instance, see fifo_peek_h
+ *
+ * @param ptr start of the committed data
+ * @param size committed size, 0 when the ring buffer is empty
+ */
+void fifo_peek(const char **ptr, size_t *size) {
+    if (!s_fifo) {
+        *ptr = NULL;
+        *size = 0;
+        return;
+    }
+    fifo_peek_h(s_fifo, ptr, size);
+}
+
+/**
+ * release the output data of the default instance, see fifo_release_h
+ *
+ * @param size released size
+ */
+void fifo_release(size_t size) {
+    if (s_fifo && size) {
+        fifo_release_h(s_fifo, size);
+    }
+}
+
+#ifdef FIFO_USING_STATS
+/**
+ * get the statistics of the default instance
+ *
+ * @param stats statistics
+ *
+ * @return result
+ */
+FifoErrCode fifo_get_stats(FifoStats *stats) {
+    return fifo_get_stats_h(s_fifo, stats);
+}
+#endif
+
+/**
+ * dropped pushes of the instance, the truncated and timed out pushes are included
+ *
+ * @param fifo instance
+ *
+ * @return dropped count
+ */
+size_t fifo_get_dropped_h(fifo_t *fifo) {
+    return fifo ? atomic_load_explicit(&fifo->dropped, memory_order_relaxed) : 0;
+}
+
+/**
+ * stream offsets of the instance, they are the free running indices. the commit offset counts the bytes
+ * committed since the ring buffer was created, the read offset the bytes released after output.
+ * a file backed ring buffer keeps them across runs.
+ * @note the indices are size_t, they wrap at 4 GiB on a 32 bit target
+ *
+ * @param fifo instance, NULL: both offsets are 0
+ * @param read read offset, the space before it is released, NULL: not needed
+ * @param commit commit offset, the data before it is readable, NULL: not needed
+ */
+void fifo_get_offsets_h(fifo_t *fifo, uint64_t *read, uint64_t *commit) {
+    if (read) {
+        *read = fifo ? atomic_load_explicit(&fifo->ring->cons_tail, memory_order_acquire) : 0;
+    }
+    if (commit) {
+        *commit = fifo ? atomic_load_explicit(&fifo->ring->prod_tail, memory_order_acquire) : 0;
+    }
+}
+
+/**
+ * offset from the record timestamps to the wall clock. the pop callback reads it once and adds it to
+ * each timestamp of the batch, it follows the wall clock steps between the calls.
+ *
+ * @return CLOCK_REALTIME minus the monotonic time, in nanoseconds
+ */
+uint64_t fifo_get_wall_offset(void) {
+    uint64_t wall = fifo_platform_get_wall_time();
+
+    return wall - fifo_platform_get_time();
 }
 
 /**
  * enable or disable logger output lock
  * @note disable this lock is not recommended except you want output system exception log
  *
+ * @param fifo instance
  * @param enabled true: enable  false: disable
  */
-static void fifo_output_lock_enabled(bool enabled) {
-    s_fifo.output_lock_enabled = enabled;
+static void fifo_output_lock_enabled(fifo_t *fifo, bool enabled) {
+    fifo->output_lock_enabled = enabled;
     /* it will re-lock or re-unlock before output lock enable */
-    if (s_fifo.output_lock_enabled) {
-        if (!s_fifo.output_is_locked_before_disable && s_fifo.output_is_locked_before_enable) {
+    if (fifo->output_lock_enabled) {
+        if (!fifo->output_is_locked_before_disable && fifo->output_is_locked_before_enable) {
             /* the output lock is unlocked before disable, and the lock will unlocking after enable */
-            fifo_output_lock();
-        } else if (s_fifo.output_is_locked_before_disable && !s_fifo.output_is_locked_before_enable) {
+            fifo_output_lock(fifo);
+        } else if (fifo->output_is_locked_before_disable && !fifo->output_is_locked_before_enable) {
             /* the output lock is locked before disable, and the lock will locking after enable */
-            fifo_output_unlock();
+            fifo_output_unlock(fifo);
         }
     }
 }
@@ -27,13 +27,14 @@
  */
 
 // #if defined(__linux__)
-#include <fifo.h>
+#include "fifo_def.h"
 
 #include "FreeRTOS_POSIX.h"
 /* System headers. */
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 /* FreeRTOS+POSIX. */
 #include "FreeRTOS_POSIX/pthread.h"
 #include "FreeRTOS_POSIX/mqueue.h"
@@ -41,6 +42,7 @@
 #include "FreeRTOS_POSIX/fcntl.h"
 #include "FreeRTOS_POSIX/errno.h"
 #include "FreeRTOS_POSIX/semaphore.h"
+#include "FreeRTOS_POSIX/sched.h"
 //#include <libposix4rtos.h>
 
 // #include <stdio.h>
@@ -52,63 +54,254 @@
 // #include <sched.h>
 // #include <semaphore.h>
 
-static pthread_mutex_t output_mutex_lock;
-static sem_t output_notice_sem;
-
-/* asynchronous output pthread thread */
-static pthread_t async_output_thread;
-
-/* thread running flag */
-bool thread_running = false;
-/* Initialize OK flag */
-static bool init_ok = false;
+/* platform data of each fifo instance */
+typedef struct {
+    pthread_mutex_t output_mutex_lock;
+    /* space notice of the blocked producers, it waits with the output lock */
+    pthread_cond_t space_notice_cond;
+    sem_t output_notice_sem;
+    /* asynchronous output pthread thread */
+    pthread_t async_output_thread;
+} FifoPort;
 
 /**
  * output lock
  */
-void fifo_platform_output_lock(void) {
-    pthread_mutex_lock(&output_mutex_lock);
+void fifo_platform_output_lock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_mutex_lock(&port->output_mutex_lock);
 }
 
 /**
  * output unlock
  */
-void fifo_platform_output_unlock(void) {
-    pthread_mutex_unlock(&output_mutex_lock);
+void fifo_platform_output_unlock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_mutex_unlock(&port->output_mutex_lock);
+}
+
+/**
+ * notifier of the semaphore, every FifoNotifyType uses it
+ */
+static void fifo_port_notify(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
+    sem_post(&port->output_notice_sem);
+}
+
+static bool fifo_port_wait(FifoNotifier *notifier, fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+    struct timespec ts;
+
+    (void)notifier;
+
+    if (!timeout_ms) {
+        return sem_wait(&port->output_notice_sem) == 0;
+    }
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    return sem_timedwait(&port->output_notice_sem, &ts) == 0;
+}
+
+static void fifo_port_clear(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
+    while (sem_trywait(&port->output_notice_sem) == 0);
+}
+
+/* no pollable notice on this port */
+static FifoNotifier fifo_port_notifier = {
+    fifo_port_notify,
+    fifo_port_wait,
+    fifo_port_clear,
+    NULL,
+};
+
+void fifo_async_put_space_notice(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_cond_broadcast(&port->space_notice_cond);
+}
+
+bool fifo_async_get_space_notice(fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+    struct timespec ts;
+
+    if (!timeout_ms) {
+        return pthread_cond_wait(&port->space_notice_cond, &port->output_mutex_lock) == 0;
+    }
+    /* FreeRTOS+POSIX condition variables wait until a CLOCK_REALTIME time */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    return pthread_cond_timedwait(&port->space_notice_cond, &port->output_mutex_lock, &ts) != ETIMEDOUT;
+}
+
+/**
+ * no shared memory ring buffer on this port, the producer lock is never used
+ */
+void fifo_platform_producer_lock(fifo_t *fifo) {
+    (void)fifo;
+}
+
+void fifo_platform_producer_unlock(fifo_t *fifo) {
+    (void)fifo;
+}
+
+/**
+ * give up the CPU
+ */
+void fifo_platform_yield(void) {
+    sched_yield();
+}
+
+/**
+ * allocate the ring buffer storage
+ *
+ * @param fifo instance
+ *
+ * @return result
+ */
+FifoErrCode fifo_platform_buf_alloc(fifo_t *fifo) {
+    /* no file mapping or shared memory on this port */
+    if (fifo->ring_path || fifo->shm_name) {
+        return FIFO_ERR_NO_MEM;
+    }
+    fifo->buf = malloc(fifo->capacity);
+    fifo->buf_mirrored = false;
+
+    return fifo->buf ? FIFO_NO_ERR : FIFO_ERR_NO_MEM;
+}
+
+/**
+ * free the ring buffer storage
+ *
+ * @param fifo instance
+ */
+void fifo_platform_buf_free(fifo_t *fifo) {
+    free(fifo->buf);
+    fifo->buf = NULL;
+}
+
+/**
+ * monotonic time
+ *
+ * @return time in nanoseconds
+ */
+uint64_t fifo_platform_get_time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * record stamp clock, the monotonic time is cheap here
+ */
+uint64_t fifo_platform_get_ticks(void) {
+    return fifo_platform_get_time();
+}
+
+uint64_t fifo_platform_ticks_to_ns(uint64_t ticks) {
+    return ticks;
+}
+
+/**
+ * wall clock time
+ *
+ * @return nanoseconds since the epoch
+ */
+uint64_t fifo_platform_get_wall_time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-void fifo_async_put_notice(void) {
-    sem_post(&output_notice_sem);
+/**
+ * single CPU, a group with FIFO_SHARD_CPU has one shard
+ */
+unsigned fifo_platform_get_cpu(void) {
+    return 0;
 }
 
-void fifo_async_get_notice(void) {
-    sem_wait(&output_notice_sem);
+unsigned fifo_platform_get_cpu_count(void) {
+    return 1;
 }
 
 /**
  * asynchronous output mode initialize
  *
+ * @param fifo instance
+ *
  * @return result
  */
-FifoErrCode fifo_async_init(void) {
+FifoErrCode fifo_async_init(fifo_t *fifo) {
     FifoErrCode result = FIFO_NO_ERR;
+    FifoPort *port;
+    pthread_attr_t thread_attr;
+    struct sched_param thread_sched_param;
+    int error = 0;
 
-    if (init_ok) {
+    if (fifo->port) {
         return result;
     }
 
-    sem_init(&output_notice_sem, 0, 0);
-    pthread_mutex_init(&output_mutex_lock, NULL);
+    port = calloc(1, sizeof(FifoPort));
+    if (!port) {
+        return FIFO_ERR_NO_MEM;
+    }
+    fifo->port = port;
+    if (!fifo->notifier) {
+        fifo->notifier = &fifo_port_notifier;
+    }
 
-    thread_running = true;
+    sem_init(&port->output_notice_sem, 0, 0);
+    pthread_mutex_init(&port->output_mutex_lock, NULL);
+    pthread_cond_init(&port->space_notice_cond, NULL);
 
-    pthread_attr_t thread_attr;
-    // thread_attr.stack_depth = 1*1024;
-    extern void async_output_task(void *arg);
-    pthread_create(&async_output_thread, &thread_attr, (void *)async_output_task, NULL);
-    pthread_attr_destroy(&thread_attr);
+    /* the first shard drains a merged group */
+    if (!fifo_has_output_thread(fifo)) {
+        return result;
+    }
+    fifo->thread_running = true;
 
-    init_ok = true;
+    /* FreeRTOS+POSIX maps the priority to the task priority, it has no affinity */
+    pthread_attr_init(&thread_attr);
+    if (fifo->thread.stack_size) {
+        error = pthread_attr_setstacksize(&thread_attr, fifo->thread.stack_size);
+    }
+    if (!error && fifo->thread.priority) {
+        thread_sched_param.sched_priority = fifo->thread.priority;
+        error = pthread_attr_setschedparam(&thread_attr, &thread_sched_param);
+    }
+    if (!error) {
+        error = pthread_create(&port->async_output_thread, &thread_attr, (void *)async_output_task, fifo);
+    }
+    pthread_attr_destroy(&thread_attr);
+    if (error) {
+        fifo->thread_running = false;
+        fifo_async_deinit(fifo);
+        errno = error;
+        return FIFO_ERR_THREAD;
+    }
 
     return result;
 }
@@ -116,22 +309,27 @@ FifoErrCode fifo_async_init(void) {
 /**
  * asynchronous output mode deinitialize
  *
+ * @param fifo instance
  */
-void fifo_async_deinit(void) {
-    if (!init_ok) {
+void fifo_async_deinit(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    if (!port) {
         return ;
     }
 
-    thread_running = false;
-
-    fifo_async_put_notice();
-
-    pthread_join(async_output_thread, NULL);
+    if (fifo->thread_running) {
+        fifo->thread_running = false;
+        fifo_notice_put(fifo);
+        pthread_join(port->async_output_thread, NULL);
+    }
     
-    sem_destroy(&output_notice_sem);
-    pthread_mutex_destroy(&output_mutex_lock);
+    sem_destroy(&port->output_notice_sem);
+    pthread_mutex_destroy(&port->output_mutex_lock);
+    pthread_cond_destroy(&port->space_notice_cond);
 
-    init_ok = false;
+    free(port);
+    fifo->port = NULL;
 }
 
 // #endif
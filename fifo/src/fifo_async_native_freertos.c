@@ -27,78 +27,277 @@
  */
 
 #if defined(_MBCS) // visual studio build
-#include <fifo.h>
+#include "fifo_def.h"
 #include <stdio.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
 
-static SemaphoreHandle_t output_notice_sem;
-static SemaphoreHandle_t output_mutex_lock;
-
-/* thread running flag */
-bool thread_running = false;
-/* Initialize OK flag */
-static bool init_ok = false;
+/* platform data of each fifo instance */
+typedef struct {
+    SemaphoreHandle_t output_notice_sem;
+    SemaphoreHandle_t output_mutex_lock;
+    /* space notice of the blocked producers */
+    SemaphoreHandle_t space_notice_sem;
+    /* given by the output task before it deletes itself */
+    SemaphoreHandle_t output_exit_sem;
+} FifoPort;
 
 /**
  * output lock
  */
-void fifo_platform_output_lock(void) {
+void fifo_platform_output_lock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
     // pthread_mutex_lock(&output_mutex_lock);
-    xSemaphoreTake(output_mutex_lock, portMAX_DELAY);
+    xSemaphoreTake(port->output_mutex_lock, portMAX_DELAY);
 }
 
 /**
  * output unlock
  */
-void fifo_platform_output_unlock(void) {
+void fifo_platform_output_unlock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
     // pthread_mutex_unlock(&output_mutex_lock);
-    xSemaphoreGive(output_mutex_lock);
+    xSemaphoreGive(port->output_mutex_lock);
 }
 
-void fifo_async_put_notice(void) {
+/**
+ * notifier of the binary semaphore, every FifoNotifyType uses it
+ */
+static void fifo_port_notify(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
     // sem_post(&output_notice_sem);
-    xSemaphoreGive(output_notice_sem);
+    xSemaphoreGive(port->output_notice_sem);
+}
+
+static bool fifo_port_wait(FifoNotifier *notifier, fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
+    return xSemaphoreTake(port->output_notice_sem, timeout_ms ? pdMS_TO_TICKS(timeout_ms) : portMAX_DELAY) == pdTRUE;
+}
+
+static void fifo_port_clear(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
+    xSemaphoreTake(port->output_notice_sem, 0);
+}
+
+/* no pollable notice on this port */
+static FifoNotifier fifo_port_notifier = {
+    fifo_port_notify,
+    fifo_port_wait,
+    fifo_port_clear,
+    NULL,
+};
+
+void fifo_async_put_space_notice(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    xSemaphoreGive(port->space_notice_sem);
+}
+
+bool fifo_async_get_space_notice(fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+    BaseType_t result;
+
+    /* the binary semaphore keeps a notice given before taking, so none is lost after unlock */
+    xSemaphoreGive(port->output_mutex_lock);
+    result = xSemaphoreTake(port->space_notice_sem, timeout_ms ? pdMS_TO_TICKS(timeout_ms) : portMAX_DELAY);
+    xSemaphoreTake(port->output_mutex_lock, portMAX_DELAY);
+
+    return result == pdTRUE;
+}
+
+/**
+ * output task entry, a FreeRTOS task must delete itself instead of return
+ */
+static void fifo_output_task_entry(void *arg) {
+    fifo_t *fifo = arg;
+    FifoPort *port = fifo->port;
+
+    async_output_task(fifo);
+    xSemaphoreGive(port->output_exit_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * delete the port semaphores
+ */
+static void fifo_port_free(FifoPort *port) {
+    if (port->output_notice_sem){
+        vSemaphoreDelete(port->output_notice_sem);
+    }
+    if (port->output_mutex_lock){
+        vSemaphoreDelete(port->output_mutex_lock);
+    }
+    if (port->space_notice_sem){
+        vSemaphoreDelete(port->space_notice_sem);
+    }
+    if (port->output_exit_sem){
+        vSemaphoreDelete(port->output_exit_sem);
+    }
+    vPortFree(port);
+}
+
+/**
+ * no shared memory ring buffer on this port, the producer lock is never used
+ */
+void fifo_platform_producer_lock(fifo_t *fifo) {
+    (void)fifo;
+}
+
+void fifo_platform_producer_unlock(fifo_t *fifo) {
+    (void)fifo;
+}
+
+/**
+ * give up the CPU
+ */
+void fifo_platform_yield(void) {
+    taskYIELD();
+}
+
+/**
+ * allocate the ring buffer storage from FreeRTOS heap
+ *
+ * @param fifo instance
+ *
+ * @return result
+ */
+FifoErrCode fifo_platform_buf_alloc(fifo_t *fifo) {
+    /* no file mapping or shared memory on this port */
+    if (fifo->ring_path || fifo->shm_name) {
+        return FIFO_ERR_NO_MEM;
+    }
+    fifo->buf = pvPortMalloc(fifo->capacity);
+    fifo->buf_mirrored = false;
+
+    return fifo->buf ? FIFO_NO_ERR : FIFO_ERR_NO_MEM;
+}
+
+/**
+ * free the ring buffer storage
+ *
+ * @param fifo instance
+ */
+void fifo_platform_buf_free(fifo_t *fifo) {
+    if (fifo->buf) {
+        vPortFree(fifo->buf);
+        fifo->buf = NULL;
+    }
+}
+
+/**
+ * monotonic time
+ *
+ * @return time in nanoseconds
+ */
+uint64_t fifo_platform_get_time(void) {
+    return (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000000ULL;
+}
+
+/**
+ * record stamp clock, the monotonic time is cheap here
+ */
+uint64_t fifo_platform_get_ticks(void) {
+    return fifo_platform_get_time();
+}
+
+uint64_t fifo_platform_ticks_to_ns(uint64_t ticks) {
+    return ticks;
 }
 
-void fifo_async_get_notice(void) {
-    xSemaphoreTake(output_notice_sem, portMAX_DELAY);
+/**
+ * no real time clock, the wall time counts from the boot
+ */
+uint64_t fifo_platform_get_wall_time(void) {
+    return fifo_platform_get_time();
+}
+
+/**
+ * single CPU, a group with FIFO_SHARD_CPU has one shard
+ */
+unsigned fifo_platform_get_cpu(void) {
+    return 0;
+}
+
+unsigned fifo_platform_get_cpu_count(void) {
+    return 1;
 }
 
 /**
  * asynchronous output mode initialize
  *
+ * @param fifo instance
+ *
  * @return result
  */
-FifoErrCode fifo_async_init(void) {
+FifoErrCode fifo_async_init(fifo_t *fifo) {
     FifoErrCode result = FIFO_NO_ERR;
+    FifoPort *port;
+    size_t depth;
+    BaseType_t created;
 
-    if (init_ok) {
+    if (fifo->port) {
         return result;
     }
 
-    thread_running = true;
-
-    // pthread_attr_t thread_attr;
-    // struct sched_param thread_sched_param;
+    port = pvPortMalloc(sizeof(FifoPort));
+    if (!port) {
+        return FIFO_ERR_NO_MEM;
+    }
+    memset(port, 0, sizeof(FifoPort));
 
     // sem_init(&output_notice_sem, 0, 0);
-    output_notice_sem = xSemaphoreCreateBinary();
-    output_mutex_lock = xSemaphoreCreateMutex();
-
-    // pthread_attr_init(&thread_attr);
-    // pthread_attr_setstacksize(&thread_attr, FIFO_ASYNC_OUTPUT_PTHREAD_STACK_SIZE);
-    // pthread_attr_setschedpolicy(&thread_attr, SCHED_RR);
-    // thread_sched_param.sched_priority = FIFO_ASYNC_OUTPUT_PTHREAD_PRIORITY;
-    // pthread_attr_setschedparam(&thread_attr, &thread_sched_param);
-    // pthread_create(&async_output_thread, &thread_attr, async_output_task, NULL);
-    // pthread_attr_destroy(&thread_attr);
+    port->output_notice_sem = xSemaphoreCreateBinary();
+    port->output_mutex_lock = xSemaphoreCreateMutex();
+    port->space_notice_sem = xSemaphoreCreateBinary();
+    port->output_exit_sem = xSemaphoreCreateBinary();
+    if (!port->output_notice_sem || !port->output_mutex_lock || !port->space_notice_sem || !port->output_exit_sem) {
+        fifo_port_free(port);
+        return FIFO_ERR_NO_MEM;
+    }
+    fifo->port = port;
+    if (!fifo->notifier) {
+        fifo->notifier = &fifo_port_notifier;
+    }
 
-    extern void async_output_task(void *arg);
-    xTaskCreate(async_output_task, "async_output_task", configMINIMAL_STACK_SIZE, NULL, (tskIDLE_PRIORITY + 2), NULL);
+    /* the first shard drains a merged group */
+    if (!fifo_has_output_thread(fifo)) {
+        return result;
+    }
+    fifo->thread_running = true;
 
-    init_ok = true;
+    /* the stack depth is in words, the policy is always preemptive by priority */
+    depth = fifo->thread.stack_size / sizeof(StackType_t);
+    if (depth < configMINIMAL_STACK_SIZE) {
+        depth = configMINIMAL_STACK_SIZE;
+    }
+#if defined(configUSE_CORE_AFFINITY) && (configUSE_CORE_AFFINITY == 1) && (configNUMBER_OF_CORES > 1)
+    created = fifo->thread.cpus[0]
+            ? xTaskCreateAffinitySet(fifo_output_task_entry, fifo->thread.name ? fifo->thread.name : "fifo_output",
+                    depth, fifo, fifo->thread.priority ? fifo->thread.priority : (tskIDLE_PRIORITY + 2),
+                    (UBaseType_t)fifo->thread.cpus[0], NULL)
+            : xTaskCreate(fifo_output_task_entry, fifo->thread.name ? fifo->thread.name : "fifo_output", depth,
+                    fifo, fifo->thread.priority ? fifo->thread.priority : (tskIDLE_PRIORITY + 2), NULL);
+#else
+    /* a single core, the affinity has nothing to choose */
+    created = xTaskCreate(fifo_output_task_entry, fifo->thread.name ? fifo->thread.name : "fifo_output", depth,
+            fifo, fifo->thread.priority ? fifo->thread.priority : (tskIDLE_PRIORITY + 2), NULL);
+#endif
+    if (created != pdPASS) {
+        fifo->thread_running = false;
+        fifo->port = NULL;
+        fifo_port_free(port);
+        return FIFO_ERR_THREAD;
+    }
 
     return result;
 }
@@ -106,29 +305,24 @@ FifoErrCode fifo_async_init(void) {
 /**
  * asynchronous output mode deinitialize
  *
+ * @param fifo instance
  */
-void fifo_async_deinit(void) {
-    if (!init_ok) {
+void fifo_async_deinit(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    if (!port) {
         return ;
     }
 
-    thread_running = false;
-
-    fifo_async_put_notice();
-
-    // pthread_join(async_output_thread, NULL);
-    
-    // sem_destroy(&output_notice_sem);
-    if (output_notice_sem){
-        vSemaphoreDelete(output_notice_sem);
-        output_notice_sem = NULL;
-    }
-    if (output_mutex_lock){
-        vSemaphoreDelete(output_mutex_lock);
-        output_mutex_lock = NULL;
+    if (fifo->thread_running) {
+        fifo->thread_running = false;
+        fifo_notice_put(fifo);
+        /* wait the output task exit, then the instance can be freed */
+        xSemaphoreTake(port->output_exit_sem, portMAX_DELAY);
     }
 
-    init_ok = false;
+    fifo_port_free(port);
+    fifo->port = NULL;
 }
 
 #endif
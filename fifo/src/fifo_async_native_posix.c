@@ -27,80 +27,915 @@
  */
 
 #if defined(__linux__)
-#include <fifo.h>
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "fifo_def.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
 #include <sys/syscall.h>
 #include <string.h>
+#include <errno.h>
 #include <sched.h>
 #include <semaphore.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+/* glibc 2.35 registers the restartable sequences area of every thread */
+#include <sys/rseq.h>
+#define FIFO_USING_RSEQ
+#endif
+#endif
 
-static pthread_mutex_t output_mutex_lock;
-static sem_t output_notice_sem;
+/* huge page size, the huge page backed ring buffer is aligned to it */
+#define FIFO_HUGE_PAGE_SIZE        (2 * 1024 * 1024)
+/* process shared objects of the shared memory ring buffer are in the header page after FifoFileHdr */
+#define FIFO_SHM_SYNC_OFFSET       512
 
-/* asynchronous output pthread thread */
-static pthread_t async_output_thread;
+/* process shared objects of the shared memory ring buffer, the collector initializes them */
+typedef struct {
+    /* producers of all processes hold it from a reservation to its commit */
+    pthread_mutex_t producer_lock;
+    /* notice of the collector output thread */
+    sem_t notice_sem;
+} FifoShmSync;
 
-/* thread running flag */
-bool thread_running = false;
-/* Initialize OK flag */
-static bool init_ok = false;
+/* platform data of each fifo instance */
+typedef struct {
+    pthread_mutex_t output_mutex_lock;
+    /* space notice of the blocked producers, it waits with the output lock */
+    pthread_cond_t space_notice_cond;
+    sem_t output_notice_sem;
+    /* output_notice_sem, or the shared memory one */
+    sem_t *notice_sem;
+    /* notice word of FIFO_NOTIFY_FUTEX, 1: notified */
+    atomic_uint output_notice_futex;
+    /* notice file of FIFO_NOTIFY_EVENTFD */
+    int output_notice_fd;
+    /* asynchronous output pthread thread */
+    pthread_t async_output_thread;
+} FifoPort;
 
 /**
  * output lock
  */
-void fifo_platform_output_lock(void) {
-    pthread_mutex_lock(&output_mutex_lock);
+void fifo_platform_output_lock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_mutex_lock(&port->output_mutex_lock);
 }
 
 /**
  * output unlock
  */
-void fifo_platform_output_unlock(void) {
-    pthread_mutex_unlock(&output_mutex_lock);
+void fifo_platform_output_unlock(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_mutex_unlock(&port->output_mutex_lock);
+}
+
+/**
+ * notifier of the FifoNotifyType, it works on the notice of the port data
+ */
+static void fifo_port_notify(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+    uint64_t value = 1;
+
+    (void)notifier;
+
+    switch (fifo->notify) {
+    case FIFO_NOTIFY_FUTEX:
+        atomic_store_explicit(&port->output_notice_futex, 1, memory_order_release);
+        syscall(SYS_futex, &port->output_notice_futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        break;
+    case FIFO_NOTIFY_EVENTFD:
+        /* the counter can not overflow with one notice for each parking */
+        while (write(port->output_notice_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+        break;
+    default:
+        sem_post(port->notice_sem);
+        break;
+    }
+}
+
+/**
+ * absolute time after timeout_ms on the clock
+ */
+static void fifo_deadline(clockid_t clock, uint32_t timeout_ms, struct timespec *ts) {
+    clock_gettime(clock, ts);
+    ts->tv_sec += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static bool fifo_port_wait(FifoNotifier *notifier, fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+    struct pollfd pfd;
+    struct timespec ts, *timeout = NULL;
+    uint64_t value, deadline = 0;
+    int result;
+
+    (void)notifier;
+
+    switch (fifo->notify) {
+    case FIFO_NOTIFY_FUTEX:
+        if (timeout_ms) {
+            deadline = fifo_platform_get_time() + (uint64_t)timeout_ms * 1000000;
+            timeout = &ts;
+        }
+        while (!atomic_exchange_explicit(&port->output_notice_futex, 0, memory_order_acquire)) {
+            if (timeout) {
+                /* the futex timeout is relative, it is recomputed after every wakeup */
+                value = fifo_platform_get_time();
+                if (value >= deadline) {
+                    return false;
+                }
+                ts.tv_sec = (deadline - value) / 1000000000;
+                ts.tv_nsec = (deadline - value) % 1000000000;
+            }
+            syscall(SYS_futex, &port->output_notice_futex, FUTEX_WAIT_PRIVATE, 0, timeout, NULL, 0);
+        }
+        break;
+    case FIFO_NOTIFY_EVENTFD:
+        /* the fd is non-blocking for clearing, poll waits for it */
+        pfd.fd = port->output_notice_fd;
+        pfd.events = POLLIN;
+        while ((result = poll(&pfd, 1, timeout_ms ? (int)timeout_ms : -1)) < 0 && errno == EINTR);
+        if (result == 0) {
+            return false;
+        }
+        while (read(port->output_notice_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+        break;
+    default:
+        if (!timeout_ms) {
+            while (sem_wait(port->notice_sem) < 0 && errno == EINTR);
+            break;
+        }
+        /* sem_timedwait only takes the realtime clock */
+        fifo_deadline(CLOCK_REALTIME, timeout_ms, &ts);
+        while ((result = sem_timedwait(port->notice_sem, &ts)) < 0 && errno == EINTR);
+        if (result < 0) {
+            return false;
+        }
+        break;
+    }
+
+    return true;
+}
+
+static void fifo_port_clear(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+    uint64_t value;
+
+    (void)notifier;
+
+    switch (fifo->notify) {
+    case FIFO_NOTIFY_FUTEX:
+        atomic_store_explicit(&port->output_notice_futex, 0, memory_order_relaxed);
+        break;
+    case FIFO_NOTIFY_EVENTFD:
+        while (read(port->output_notice_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+        break;
+    default:
+        while (sem_trywait(port->notice_sem) == 0 || errno == EINTR);
+        break;
+    }
+}
+
+static int fifo_port_get_fd(FifoNotifier *notifier, fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    (void)notifier;
+    return fifo->notify == FIFO_NOTIFY_EVENTFD ? port->output_notice_fd : -1;
+}
+
+static FifoNotifier fifo_port_notifier = {
+    fifo_port_notify,
+    fifo_port_wait,
+    fifo_port_clear,
+    fifo_port_get_fd,
+};
+
+void fifo_async_put_space_notice(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    pthread_cond_broadcast(&port->space_notice_cond);
+}
+
+bool fifo_async_get_space_notice(fifo_t *fifo, uint32_t timeout_ms) {
+    FifoPort *port = fifo->port;
+    struct timespec ts;
+
+    if (!timeout_ms) {
+        return pthread_cond_wait(&port->space_notice_cond, &port->output_mutex_lock) == 0;
+    }
+    fifo_deadline(CLOCK_MONOTONIC, timeout_ms, &ts);
+
+    return pthread_cond_timedwait(&port->space_notice_cond, &port->output_mutex_lock, &ts) != ETIMEDOUT;
+}
+
+/**
+ * process shared objects of the shared memory ring buffer
+ */
+static FifoShmSync *fifo_shm_sync(fifo_t *fifo) {
+    return (FifoShmSync *)((char *)fifo->ring_hdr + FIFO_SHM_SYNC_OFFSET);
+}
+
+/**
+ * shared memory producer lock, a robust mutex
+ * @note a producer process may die with the lock. it never published the reserved space,
+ *       the commit index is unchanged, so the next producer only marks the lock consistent.
+ */
+void fifo_platform_producer_lock(fifo_t *fifo) {
+    FifoShmSync *sync = fifo_shm_sync(fifo);
+
+    if (pthread_mutex_lock(&sync->producer_lock) == EOWNERDEAD) {
+        atomic_store_explicit(&fifo->ring->prod_head, atomic_load_explicit(&fifo->ring->prod_tail,
+                memory_order_relaxed), memory_order_relaxed);
+        pthread_mutex_consistent(&sync->producer_lock);
+    }
+}
+
+/**
+ * shared memory producer unlock
+ */
+void fifo_platform_producer_unlock(fifo_t *fifo) {
+    pthread_mutex_unlock(&fifo_shm_sync(fifo)->producer_lock);
+}
+
+/**
+ * initialize the process shared objects, only the collector does it
+ *
+ * @return 0: success
+ */
+static int fifo_shm_sync_init(FifoShmSync *sync) {
+    pthread_mutexattr_t attr;
+    int result;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    result = pthread_mutex_init(&sync->producer_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (result == 0) {
+        result = sem_init(&sync->notice_sem, 1, 0);
+    }
+
+    return result;
+}
+
+/**
+ * give up the CPU
+ */
+void fifo_platform_yield(void) {
+    sched_yield();
+}
+
+/**
+ * map the storage file twice back to back
+ *
+ * @param fd storage file
+ * @param offset storage file offset
+ * @param size storage size
+ * @param align mapping alignment
+ * @param map_flags extra mmap flags
+ *
+ * @return start address, MAP_FAILED when failed
+ */
+static char *fifo_buf_map_mirror(int fd, off_t offset, size_t size, size_t align, int map_flags) {
+    char *area, *base;
+    size_t area_size = size * 2 + align;
+
+    /* reserve the address range first, then replace it with the two views */
+    area = mmap(NULL, area_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    base = (char *)(((uintptr_t)area + align - 1) & ~((uintptr_t)align - 1));
+    if (base > area) {
+        munmap(area, base - area);
+    }
+    munmap(base + size * 2, area + area_size - (base + size * 2));
+
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | map_flags, fd, offset) == MAP_FAILED
+            || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | map_flags, fd, offset) == MAP_FAILED) {
+        munmap(base, size * 2);
+        return MAP_FAILED;
+    }
+
+    return base;
+}
+
+/**
+ * map a mirrored storage backed by an anonymous memory file
+ *
+ * @return start address, MAP_FAILED when failed
+ */
+static char *fifo_buf_alloc_mirror(size_t size, bool huge, int map_flags) {
+    char *buf = MAP_FAILED;
+    int fd;
+
+    fd = memfd_create("fifo", MFD_CLOEXEC | (huge ? MFD_HUGETLB : 0));
+    if (fd < 0) {
+        return MAP_FAILED;
+    }
+    if (ftruncate(fd, size) == 0) {
+        buf = fifo_buf_map_mirror(fd, 0, size, huge ? FIFO_HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE), map_flags);
+    }
+    /* the mappings keep the memory file alive */
+    close(fd);
+
+    return buf;
+}
+
+/**
+ * check the header written by another instance
+ *
+ * @return true when the header is valid and consistent
+ */
+static bool fifo_ring_hdr_valid(const FifoFileHdr *hdr, size_t page_size, size_t file_size) {
+    return hdr->magic == FIFO_FILE_MAGIC && hdr->version == FIFO_FILE_VERSION && hdr->data_offset == page_size
+            && hdr->capacity >= page_size && !(hdr->capacity & (hdr->capacity - 1))
+            && file_size >= hdr->data_offset + hdr->capacity
+            && hdr->prod_tail - hdr->cons_tail <= hdr->capacity && hdr->prod_head - hdr->prod_tail <= hdr->capacity;
+}
+
+/**
+ * map the file or shared memory ring buffer, the header page holds the ring state and the storage follows it.
+ * the unread data of the last run is kept when the header matches this instance.
+ * a shared memory producer takes the capacity and the record format from the header instead.
+ * @note the reservations which were not committed before a crash are dropped.
+ *       only one collector process may map it, readers map it read only.
+ *
+ * @param fifo instance
+ * @param map_flags extra mmap flags
+ *
+ * @return start address, MAP_FAILED when failed
+ */
+static char *fifo_buf_alloc_file(fifo_t *fifo, int map_flags) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uint32_t format_flags = FIFO_FLAG_FRAMED | FIFO_FLAG_SEQ | FIFO_FLAG_TIMESTAMP;
+    bool attach = fifo->flags & FIFO_FLAG_SHM_PRODUCER;
+    FifoFileHdr *hdr;
+    struct stat st;
+    char *buf;
+    int fd;
+
+    /* the header ring state is used as FifoRingState of the core, the line size must match the file */
+    if (sizeof(size_t) != sizeof(uint64_t) || sizeof(atomic_uint) != sizeof(uint32_t)
+            || offsetof(FifoFileHdr, prod_tail) - offsetof(FifoFileHdr, prod_head) != offsetof(FifoRingState, prod_tail)
+            || offsetof(FifoFileHdr, cons_tail) - offsetof(FifoFileHdr, prod_head) != offsetof(FifoRingState, cons_tail)
+            || offsetof(FifoFileHdr, consumer_parked) - offsetof(FifoFileHdr, prod_head)
+                    != offsetof(FifoRingState, consumer_parked)
+            || sizeof(FifoFileHdr) > FIFO_SHM_SYNC_OFFSET || FIFO_SHM_SYNC_OFFSET + sizeof(FifoShmSync) > page_size) {
+        return MAP_FAILED;
+    }
+
+    if (fifo->shm_name) {
+        fd = shm_open(fifo->shm_name, O_RDWR | (attach ? 0 : O_CREAT), 0600);
+    } else {
+        fd = open(fifo->ring_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        return MAP_FAILED;
+    }
+    if (fstat(fd, &st) < 0 || (!attach && (size_t)st.st_size < page_size + fifo->capacity
+            && ftruncate(fd, page_size + fifo->capacity) < 0) || (attach && (size_t)st.st_size < page_size)) {
+        close(fd);
+        return MAP_FAILED;
+    }
+    hdr = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        close(fd);
+        return MAP_FAILED;
+    }
+
+    if (attach) {
+        /* the collector has not created it */
+        if (!fifo_ring_hdr_valid(hdr, page_size, st.st_size)) {
+            goto __fail;
+        }
+        fifo->capacity = hdr->capacity;
+        fifo->flags = (fifo->flags & ~format_flags) | hdr->flags;
+    } else if (fifo_ring_hdr_valid(hdr, page_size, page_size + fifo->capacity) && hdr->capacity == fifo->capacity
+            && hdr->flags == (fifo->flags & format_flags)) {
+        /* recover, the committed data is output again by the output thread */
+        hdr->prod_head = hdr->prod_tail;
+        hdr->consumer_parked = 0;
+    } else {
+        /* a new file or another format, the magic is written last so a torn header is never valid */
+        memset(hdr, 0, sizeof(FifoFileHdr));
+        hdr->version = FIFO_FILE_VERSION;
+        hdr->data_offset = page_size;
+        hdr->capacity = fifo->capacity;
+        hdr->flags = fifo->flags & format_flags;
+    }
+    /* the producers of the last run are gone, start the collector before the new ones */
+    if (fifo->shm_name && !attach && fifo_shm_sync_init((FifoShmSync *)((char *)hdr + FIFO_SHM_SYNC_OFFSET)) != 0) {
+        goto __fail;
+    }
+    __atomic_store_n(&hdr->magic, FIFO_FILE_MAGIC, __ATOMIC_RELEASE);
+
+    fifo->buf_mirrored = true;
+    buf = fifo_buf_map_mirror(fd, page_size, fifo->capacity, page_size, map_flags);
+    if (buf == MAP_FAILED) {
+        fifo->buf_mirrored = false;
+        buf = mmap(NULL, fifo->capacity, PROT_READ | PROT_WRITE, MAP_SHARED | map_flags, fd, page_size);
+    }
+    if (buf == MAP_FAILED) {
+        goto __fail;
+    }
+    /* the mappings keep the file open */
+    close(fd);
+    fifo->ring_hdr = hdr;
+    fifo->ring = (FifoRingState *)&hdr->prod_head;
+
+    return buf;
+
+__fail:
+    munmap(hdr, page_size);
+    close(fd);
+    return MAP_FAILED;
+}
+
+/**
+ * prefer the NUMA node of the CPU for the storage, it is a hint and nothing happens on a single node system.
+ * the pages are only touched by the first pushes, those faulted by MAP_POPULATE are moved
+ */
+static void fifo_buf_bind_node(char *buf, size_t size, int cpu) {
+    char path[64];
+    struct dirent *entry;
+    unsigned long mask;
+    int node = -1;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    if (node < 0 || node >= (int)(sizeof(mask) * 8)) {
+        return;
+    }
+    mask = 1UL << node;
+    syscall(SYS_mbind, buf, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, MPOL_MF_MOVE);
+}
+
+/**
+ * allocate the ring buffer storage with mmap
+ * @note huge pages come from the reserved hugetlb pool first, then from transparent huge pages.
+ *       mlock is best effort, it fails beyond RLIMIT_MEMLOCK but the storage is still prefaulted.
+ *
+ * @param fifo instance
+ *
+ * @return result
+ */
+FifoErrCode fifo_platform_buf_alloc(fifo_t *fifo) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    bool huge = (fifo->flags & FIFO_FLAG_HUGE_PAGE) && fifo->capacity >= FIFO_HUGE_PAGE_SIZE;
+    int map_flags = (fifo->flags & FIFO_FLAG_MLOCK) ? MAP_POPULATE : 0;
+    char *buf = MAP_FAILED;
+
+    /* both power of 2, so the capacity is also a multiple of page size */
+    if (fifo->capacity < page_size) {
+        fifo->capacity = page_size;
+    }
+
+    if (fifo->ring_path || fifo->shm_name) {
+        /* the file pages come from the page cache, huge pages are only advised */
+        buf = fifo_buf_alloc_file(fifo, map_flags);
+    } else {
+        fifo->buf_mirrored = true;
+        if (huge) {
+            buf = fifo_buf_alloc_mirror(fifo->capacity, true, map_flags);
+        }
+        if (buf == MAP_FAILED) {
+            buf = fifo_buf_alloc_mirror(fifo->capacity, false, map_flags);
+        }
+    }
+    if (buf == MAP_FAILED && !fifo->ring_path && !fifo->shm_name) {
+        /* no memory file, use a single mapping */
+        fifo->buf_mirrored = false;
+        if (huge) {
+            buf = mmap(NULL, fifo->capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | map_flags, -1, 0);
+        }
+        if (buf == MAP_FAILED) {
+            buf = mmap(NULL, fifo->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | map_flags, -1, 0);
+        }
+    }
+    if (buf == MAP_FAILED) {
+        return FIFO_ERR_NO_MEM;
+    }
+
+    if (fifo->numa_cpu >= 0 && !fifo->ring_path) {
+        fifo_buf_bind_node(buf, fifo->capacity, fifo->numa_cpu);
+    }
+    if (fifo->flags & FIFO_FLAG_HUGE_PAGE) {
+        madvise(buf, fifo->capacity, MADV_HUGEPAGE);
+    }
+    if (fifo->flags & FIFO_FLAG_MLOCK) {
+        mlock(buf, fifo->buf_mirrored ? fifo->capacity * 2 : fifo->capacity);
+    }
+    fifo->buf = buf;
+
+    return FIFO_NO_ERR;
+}
+
+/**
+ * free the ring buffer storage
+ *
+ * @param fifo instance
+ */
+void fifo_platform_buf_free(fifo_t *fifo) {
+    if (!fifo->buf) {
+        return;
+    }
+
+    munmap(fifo->buf, fifo->buf_mirrored ? fifo->capacity * 2 : fifo->capacity);
+    fifo->buf = NULL;
+    if (fifo->ring_hdr) {
+        /* the file stays for the next run and the readers */
+        fifo->ring = &fifo->ring_local;
+        munmap(fifo->ring_hdr, ((FifoFileHdr *)fifo->ring_hdr)->data_offset);
+        fifo->ring_hdr = NULL;
+    }
+}
+
+/**
+ * monotonic time
+ *
+ * @return time in nanoseconds
+ */
+uint64_t fifo_platform_get_time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the calibration spins this long, the error of the rate is about the clock resolution divided by it */
+#define FIFO_TICKS_CALIBRATE_NS                  (5 * 1000000ULL)
+
+static pthread_once_t fifo_ticks_once = PTHREAD_ONCE_INIT;
+/* ns = fifo_ticks_ns0 + ((ticks - fifo_ticks0) * fifo_ticks_mult >> 32), 0 mult: ticks are coarse nanoseconds */
+static uint64_t fifo_ticks0, fifo_ticks_ns0, fifo_ticks_mult;
+
+/**
+ * read the CPU counter
+ */
+static inline uint64_t fifo_ticks_read(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+/**
+ * read the counter and the monotonic time together, the counter is taken in the middle of the
+ * shortest of a few tries so a preemption does not skew the pair
+ */
+static void fifo_ticks_sample(uint64_t *ticks, uint64_t *ns) {
+    uint64_t before, after, time, best = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        before = fifo_ticks_read();
+        time = fifo_platform_get_time();
+        after = fifo_ticks_read();
+        if (after - before < best) {
+            best = after - before;
+            *ticks = before + best / 2;
+            *ns = time;
+        }
+    }
+}
+#endif
+
+/**
+ * measure the counter rate against CLOCK_MONOTONIC once per process, on the first create with FIFO_FLAG_TIMESTAMP.
+ * the TSC is only used when it is invariant, it runs at a fixed rate through the frequency and sleep states
+ */
+static void fifo_ticks_calibrate(void) {
+    uint64_t ticks = 0, ns = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8))) {
+        return;
+    }
+    fifo_ticks_sample(&fifo_ticks0, &fifo_ticks_ns0);
+    do {
+        fifo_ticks_sample(&ticks, &ns);
+    } while (ns - fifo_ticks_ns0 < FIFO_TICKS_CALIBRATE_NS);
+    if (ticks > fifo_ticks0) {
+        fifo_ticks_mult = ((ns - fifo_ticks_ns0) << 32) / (ticks - fifo_ticks0);
+    }
+#elif defined(__aarch64__)
+    uint64_t freq;
+
+    /* the generic timer reports its rate */
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+    if (freq) {
+        fifo_ticks_sample(&fifo_ticks0, &fifo_ticks_ns0);
+        fifo_ticks_mult = (1000000000ULL << 32) / freq;
+    }
+    (void)ticks;
+    (void)ns;
+#else
+    (void)ticks;
+    (void)ns;
+#endif
+}
+
+/**
+ * record stamp clock, the invariant TSC or the generic timer when it is calibrated,
+ * CLOCK_MONOTONIC_COARSE otherwise
+ *
+ * @return ticks, fifo_platform_ticks_to_ns converts them
+ */
+uint64_t fifo_platform_get_ticks(void) {
+    struct timespec ts;
+
+    if (fifo_ticks_mult) {
+        return fifo_ticks_read();
+    }
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * convert the stamp clock to the monotonic time
+ *
+ * @param ticks fifo_platform_get_ticks value
+ *
+ * @return time in nanoseconds
+ */
+uint64_t fifo_platform_ticks_to_ns(uint64_t ticks) {
+    if (!fifo_ticks_mult) {
+        return ticks;
+    }
+
+    ticks -= fifo_ticks0;
+#ifdef __SIZEOF_INT128__
+    return fifo_ticks_ns0 + (uint64_t)(((unsigned __int128)ticks * fifo_ticks_mult) >> 32);
+#else
+    return fifo_ticks_ns0 + (ticks >> 32) * fifo_ticks_mult + (((ticks & 0xFFFFFFFF) * fifo_ticks_mult) >> 32);
+#endif
 }
 
-void fifo_async_put_notice(void) {
-    sem_post(&output_notice_sem);
+/**
+ * wall clock time
+ *
+ * @return nanoseconds since the epoch
+ */
+uint64_t fifo_platform_get_wall_time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-void fifo_async_get_notice(void) {
-    sem_wait(&output_notice_sem);
+/**
+ * CPU of the calling thread, the kernel keeps it in the restartable sequences area so no system call is made
+ *
+ * @return CPU number
+ */
+unsigned fifo_platform_get_cpu(void) {
+    int cpu;
+
+#ifdef FIFO_USING_RSEQ
+    if (__rseq_size) {
+        const struct rseq *rs = (const struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+
+        cpu = (int)__atomic_load_n(&rs->cpu_id, __ATOMIC_RELAXED);
+        if (cpu >= 0) {
+            return (unsigned)cpu;
+        }
+    }
+#endif
+    cpu = sched_getcpu();
+
+    return cpu < 0 ? 0 : (unsigned)cpu;
+}
+
+/**
+ * configured CPU count, a CPU brought online later has its own shard too
+ *
+ * @return CPU count
+ */
+unsigned fifo_platform_get_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_CONF);
+
+    return count > 0 ? (unsigned)count : 1;
+}
+
+/* smallest output thread stack, glibc also takes the static TLS of the process from it */
+#define FIFO_THREAD_STACK_MIN                    (64 * 1024)
+
+/**
+ * read the isolated CPUs of the kernel, the list is like "2-3,6"
+ *
+ * @param set isolated CPUs, it is empty when nothing is isolated
+ */
+static void fifo_isolated_cpus(cpu_set_t *set) {
+    FILE *fp = fopen("/sys/devices/system/cpu/isolated", "r");
+    unsigned first, last;
+    int c;
+
+    CPU_ZERO(set);
+    if (!fp) {
+        return;
+    }
+    while (fscanf(fp, "%u", &first) == 1) {
+        last = first;
+        c = fgetc(fp);
+        if (c == '-') {
+            if (fscanf(fp, "%u", &last) != 1) {
+                break;
+            }
+            c = fgetc(fp);
+        }
+        for (; first <= last && first < CPU_SETSIZE; first++) {
+            CPU_SET(first, set);
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+/**
+ * set the output thread attributes from the configuration.
+ * the default thread inherits the policy of the creating thread and has the default stack
+ *
+ * @param cfg output thread configuration
+ * @param attr thread attributes
+ *
+ * @return 0, or the error number
+ */
+static int fifo_thread_attr(const FifoThreadCfg *cfg, pthread_attr_t *attr) {
+    static const int policies[] = { SCHED_OTHER, SCHED_OTHER, SCHED_FIFO, SCHED_RR };
+    struct sched_param param = { 0 };
+    cpu_set_t cpus, isolated;
+    bool affinity = cfg->isolated;
+    size_t stack_min = PTHREAD_STACK_MIN > FIFO_THREAD_STACK_MIN ? PTHREAD_STACK_MIN : FIFO_THREAD_STACK_MIN;
+    int result, policy;
+    unsigned i;
+
+    CPU_ZERO(&cpus);
+    for (i = 0; i < FIFO_THREAD_CPUS_MAX; i++) {
+        if (cfg->cpus[i / 64] & (1ULL << (i % 64))) {
+            CPU_SET(i, &cpus);
+            affinity = true;
+        }
+    }
+    if (cfg->isolated) {
+        fifo_isolated_cpus(&isolated);
+        if (CPU_COUNT(&cpus)) {
+            CPU_AND(&cpus, &cpus, &isolated);
+        } else {
+            cpus = isolated;
+        }
+        if (!CPU_COUNT(&cpus)) {
+            return EINVAL;
+        }
+    }
+    if (affinity && (result = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus)) != 0) {
+        return result;
+    }
+    if (cfg->stack_size && (result = pthread_attr_setstacksize(attr,
+            cfg->stack_size < stack_min ? stack_min : cfg->stack_size)) != 0) {
+        return result;
+    }
+    if ((unsigned)cfg->policy >= sizeof(policies) / sizeof(policies[0])) {
+        return EINVAL;
+    }
+    if (cfg->policy != FIFO_SCHED_DEFAULT) {
+        policy = policies[cfg->policy];
+        if (policy != SCHED_OTHER) {
+            param.sched_priority = cfg->priority ? cfg->priority : sched_get_priority_min(policy);
+        }
+        if ((result = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED)) != 0
+                || (result = pthread_attr_setschedpolicy(attr, policy)) != 0
+                || (result = pthread_attr_setschedparam(attr, &param)) != 0) {
+            return result;
+        }
+    }
+
+    return 0;
 }
 
 /**
  * asynchronous output mode initialize
  *
+ * @param fifo instance
+ *
  * @return result
  */
-FifoErrCode fifo_async_init(void) {
+FifoErrCode fifo_async_init(fifo_t *fifo) {
     FifoErrCode result = FIFO_NO_ERR;
+    FifoPort *port;
 
-    if (init_ok) {
+    if (fifo->port) {
         return result;
     }
+    /* the stamp clock is ready before a producer gets the instance, only the stamped ones pay for it */
+    if (fifo->flags & FIFO_FLAG_TIMESTAMP) {
+        pthread_once(&fifo_ticks_once, fifo_ticks_calibrate);
+    }
+
+    port = calloc(1, sizeof(FifoPort));
+    if (!port) {
+        return FIFO_ERR_NO_MEM;
+    }
 
     pthread_attr_t thread_attr;
-    struct sched_param thread_sched_param;
+    pthread_condattr_t cond_attr;
+    char name[16];
+    int error;
 
-    sem_init(&output_notice_sem, 0, 0);
-    pthread_mutex_init(&output_mutex_lock, NULL);
+    port->output_notice_fd = -1;
+    if (fifo->notify == FIFO_NOTIFY_EVENTFD && !fifo->notifier) {
+        port->output_notice_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (port->output_notice_fd < 0) {
+            free(port);
+            return FIFO_ERR_NO_MEM;
+        }
+    }
+    fifo->port = port;
+    if (!fifo->notifier) {
+        fifo->notifier = &fifo_port_notifier;
+    }
 
-    thread_running = true;
+    sem_init(&port->output_notice_sem, 0, 0);
+    port->notice_sem = fifo->shared ? &fifo_shm_sync(fifo)->notice_sem : &port->output_notice_sem;
+    atomic_init(&port->output_notice_futex, 0);
+    pthread_mutex_init(&port->output_mutex_lock, NULL);
+    /* the space wait timeout follows the monotonic clock like fifo_platform_get_time */
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&port->space_notice_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
 
-    pthread_attr_init(&thread_attr);
-    pthread_attr_setstacksize(&thread_attr, (1*1024));
-    pthread_attr_setschedpolicy(&thread_attr, SCHED_RR);
-    thread_sched_param.sched_priority = (sched_get_priority_max(SCHED_RR) - 1);
-    pthread_attr_setschedparam(&thread_attr, &thread_sched_param);
+    /* the collector process drains the shared memory ring buffer, the first shard drains a merged group */
+    if (!fifo_has_output_thread(fifo)) {
+        return result;
+    }
+    fifo->thread_running = true;
 
-    extern void async_output_task(void *arg);
-    pthread_create(&async_output_thread, &thread_attr, (void *)async_output_task, NULL);
+    pthread_attr_init(&thread_attr);
+    error = fifo_thread_attr(&fifo->thread, &thread_attr);
+    if (!error) {
+        error = pthread_create(&port->async_output_thread, &thread_attr, (void *)async_output_task, fifo);
+    }
     pthread_attr_destroy(&thread_attr);
-
-    init_ok = true;
+    if (error) {
+        fifo->thread_running = false;
+        fifo_async_deinit(fifo);
+        errno = error;
+        return FIFO_ERR_THREAD;
+    }
+    /* the name is only for the tools, the kernel keeps 15 characters */
+    snprintf(name, sizeof(name), "%s", fifo->thread.name ? fifo->thread.name : "fifo_output");
+    pthread_setname_np(port->async_output_thread, name);
 
     return result;
 }
@@ -108,22 +943,30 @@ FifoErrCode fifo_async_init(void) {
 /**
  * asynchronous output mode deinitialize
  *
+ * @param fifo instance
  */
-void fifo_async_deinit(void) {
-    if (!init_ok) {
+void fifo_async_deinit(fifo_t *fifo) {
+    FifoPort *port = fifo->port;
+
+    if (!port) {
         return ;
     }
 
-    thread_running = false;
-
-    fifo_async_put_notice();
+    if (fifo->thread_running) {
+        fifo->thread_running = false;
+        fifo_notice_put(fifo);
+        pthread_join(port->async_output_thread, NULL);
+    }
 
-    pthread_join(async_output_thread, NULL);
-    
-    sem_destroy(&output_notice_sem);
-    pthread_mutex_destroy(&output_mutex_lock);
+    sem_destroy(&port->output_notice_sem);
+    pthread_mutex_destroy(&port->output_mutex_lock);
+    pthread_cond_destroy(&port->space_notice_cond);
+    if (port->output_notice_fd >= 0) {
+        close(port->output_notice_fd);
+    }
 
-    init_ok = false;
+    free(port);
+    fifo->port = NULL;
 }
 
 #endif
@@ -0,0 +1,292 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Private definitions shared by the fifo core and the platform ports.
+ * Created on: 2026-10-17
+ */
+
+#ifndef __FIFO_DEF_H__
+#define __FIFO_DEF_H__
+
+#include <fifo.h>
+#include <fifo_file.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/* thread local storage qualifier, every producer thread formats into its own buffer */
+#ifndef FIFO_THREAD_LOCAL
+#define FIFO_THREAD_LOCAL                           _Thread_local
+#endif
+/* cache line size, the data written by different threads is kept on different lines */
+#ifndef FIFO_CACHE_LINE_SIZE
+#define FIFO_CACHE_LINE_SIZE                        64
+#endif
+
+/* ring buffer state, the layout is the same as the prod_head to consumer_parked part of FifoFileHdr.
+ * the indices are free running and only masked when the storage is accessed. every line has one writer side,
+ * so a push does not take the line the consumer writes on release, and the other way round */
+typedef struct {
+    /* log ring buffer reserve index, producers claim space by moving it forward */
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_size_t prod_head;
+    /* read index last seen by the producers, it is never newer than cons_tail.
+     * the producers only read cons_tail when this one shows no space */
+    atomic_size_t cons_cache;
+    /* log ring buffer commit index, data before it is readable by the consumer */
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_size_t prod_tail;
+    /* next record sequence number, only the producer which is committing writes it */
+    uint64_t seq;
+    /* log ring buffer read index, only the consumer moves it forward */
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_size_t cons_tail;
+    /* the output thread is blocked on the notice, producers signal it only in this state.
+     * every commit reads it, the output thread only writes it when it parks */
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_uint consumer_parked;
+} FifoRingState;
+
+/* fifo instance */
+struct fifo_instance {
+    /* ring buffer state, ring_local or the header of the file or shared memory ring buffer */
+    FifoRingState *ring;
+    FifoRingState ring_local;
+    /* FIFO_FLAG_xxx */
+    uint32_t flags;
+    FifoCallbacks cbs;
+    /* output sink, it releases the space of the output data itself */
+    FifoSink *sink;
+    /* record header size with the optional stamps in framed mode */
+    size_t rec_hdr_size;
+    volatile bool output_enabled;
+    bool output_lock_enabled;
+    bool output_is_locked_before_enable;
+    bool output_is_locked_before_disable;
+    /* output thread spin time before it parks */
+    uint64_t spin_ns;
+    /* FifoNotifyType, it is used by the port */
+    int notify;
+    /* notice of the consumer, the configured one or the port one of notify */
+    FifoNotifier *notifier;
+    /* output thread running flag, it is managed by the port */
+    volatile bool thread_running;
+    /* output thread configuration, the port reads it on initialize */
+    FifoThreadCfg thread;
+    /* FIFO_FLAG_NO_THREAD inline drain size, 0: never */
+    size_t high_water;
+    /* platform data: lock, notice and output thread, it is managed by the port */
+    void *port;
+    /* log ring buffer storage, it is allocated by the port */
+    char *buf;
+    /* log ring buffer capacity, power of 2 */
+    size_t capacity;
+    /* the storage is mapped twice back to back, so any span of capacity bytes is contiguous */
+    bool buf_mirrored;
+    /* file backed ring buffer path, NULL: memory only */
+    const char *ring_path;
+    /* shared memory ring buffer name, NULL: private */
+    const char *shm_name;
+    /* the ring buffer is shared with the producers of other processes, they are serialized by the producer lock */
+    bool shared;
+    /* file backed ring buffer header mapping, it is managed by the port */
+    void *ring_hdr;
+    /* FifoOverflow */
+    int overflow;
+    /* FIFO_OVERFLOW_BLOCK wait time, 0: wait forever */
+    uint64_t block_timeout_ns;
+    /* producers waiting for space, the consumer signals them after it releases space */
+    atomic_size_t space_waiters;
+    /* pushes dropped whole or partly */
+    atomic_size_t dropped;
+    /* FIFO_OVERFLOW_OVERWRITE output buffer, the data is copied out before producers overwrite it */
+    char *copy_buf;
+    /* FIFO_OVERFLOW_SPILL file, it is accessed with the output lock */
+    FILE *spill_file;
+    /* spill file write and replay positions */
+    size_t spill_wpos;
+    size_t spill_rpos;
+    /* the spill file has data, every push goes to it to keep the order */
+    atomic_bool spill_active;
+    /* spill file replay buffer */
+    char *spill_buf;
+    size_t spill_buf_size;
+    /* the output thread formats the deferred records of a batch into it */
+    char *fmt_buf;
+#ifdef FIFO_USING_STATS
+    /* statistics, it is managed by fifo_stats.c */
+    struct fifo_stats *stats;
+#endif
+    /* instance group of the shard, NULL: standalone instance */
+    struct fifo_group *group;
+    /* the storage is allocated on the NUMA node of this CPU, -1: no binding */
+    int numa_cpu;
+    /* output index of the output thread, cons_tail follows it when the sink releases the space.
+     * it is written on every output, so it is kept off the lines the producers read */
+    _Alignas(FIFO_CACHE_LINE_SIZE) size_t cons_head;
+    /* a thread drains the instance by fifo_poll_h, the others return at once */
+    atomic_bool polling;
+    /* an event loop waits for the notice, fifo_poll_h parks for it */
+    atomic_bool notice_armed;
+};
+
+/* parsed records of a shard waiting for their turn in the merge */
+typedef struct {
+    FifoRecord records[FIFO_POP_RECORDS_MAX];
+    /* index after each record */
+    size_t ends[FIFO_POP_RECORDS_MAX];
+    /* index after the batch, the padding after the last record is included */
+    size_t end;
+    size_t count;
+    /* next record to output */
+    size_t pos;
+} FifoMergeBatch;
+
+/* instance group, it is managed by fifo_group.c */
+struct fifo_group {
+    /* next sequence number of all shards with FIFO_ORDER_SEQ, the committing producers take it */
+    atomic_uint_fast64_t seq;
+    char seq_pad[FIFO_CACHE_LINE_SIZE - sizeof(atomic_uint_fast64_t)];
+    FifoOrder order;
+    /* next sequence number to output, only the merging output thread uses it */
+    uint64_t next_seq;
+    /* one batch for each shard of a merged order */
+    FifoMergeBatch *batches;
+    FifoShardBy shard_by;
+    size_t count;
+    fifo_t *shards[FIFO_GROUP_SHARDS_MAX];
+};
+
+/**
+ * the output thread of the instance merges all shards of its group
+ */
+static inline bool fifo_is_merger(const fifo_t *fifo) {
+    return fifo->group && fifo->group->order != FIFO_ORDER_NONE && fifo == fifo->group->shards[0];
+}
+
+/**
+ * the instance has its own output thread, a merged shard, a shared memory producer and an instance drained
+ * by its owner have none
+ */
+static inline bool fifo_has_output_thread(const fifo_t *fifo) {
+    return !(fifo->flags & (FIFO_FLAG_SHM_PRODUCER | FIFO_FLAG_NO_THREAD))
+            && !(fifo->group && fifo->group->order != FIFO_ORDER_NONE && fifo != fifo->group->shards[0]);
+}
+
+/**
+ * notice of the consumer
+ */
+static inline void fifo_notice_put(fifo_t *fifo) {
+    fifo->notifier->notify(fifo->notifier, fifo);
+}
+
+static inline bool fifo_notice_wait(fifo_t *fifo, uint32_t timeout_ms) {
+    return fifo->notifier->wait(fifo->notifier, fifo, timeout_ms);
+}
+
+static inline void fifo_notice_clear(fifo_t *fifo) {
+    if (fifo->notifier->clear) {
+        fifo->notifier->clear(fifo->notifier, fifo);
+    }
+}
+
+static inline int fifo_notice_fd(fifo_t *fifo) {
+    return fifo->notifier->get_fd ? fifo->notifier->get_fd(fifo->notifier, fifo) : -1;
+}
+
+/**
+ * the instance whose output drains this one, the first shard of a merged group.
+ * the first shard is created last, it is NULL before
+ */
+static inline fifo_t *fifo_drainer(fifo_t *fifo) {
+    return fifo->group && fifo->group->order != FIFO_ORDER_NONE ? fifo->group->shards[0] : fifo;
+}
+
+/* fifo.c, create shard index of the group, it is put in the group before the output thread starts */
+fifo_t *fifo_create_shard(const FifoCfg *cfg, struct fifo_group *group, size_t index, FifoErrCode *result);
+
+/* port interface, every platform port implements them for each instance.
+ * the initialize sets fifo->notifier to the notifier of fifo->notify when the configuration has none */
+FifoErrCode fifo_async_init(fifo_t *fifo);
+void fifo_async_deinit(fifo_t *fifo);
+void fifo_platform_output_lock(fifo_t *fifo);
+void fifo_platform_output_unlock(fifo_t *fifo);
+/* space notice of the blocked producers, both are called with the output lock held.
+ * the getter releases the lock while waiting, timeout 0 means forever, it returns false on timeout */
+void fifo_async_put_space_notice(fifo_t *fifo);
+bool fifo_async_get_space_notice(fifo_t *fifo, uint32_t timeout_ms);
+/* producer lock of the shared memory ring buffer, it is held from a reservation to its commit.
+ * it is only called when fifo->shared */
+void fifo_platform_producer_lock(fifo_t *fifo);
+void fifo_platform_producer_unlock(fifo_t *fifo);
+void fifo_platform_yield(void);
+/* monotonic time in nanoseconds */
+uint64_t fifo_platform_get_time(void);
+/* record stamp clock, it is cheaper than fifo_platform_get_time. the ticks only mean time after
+ * fifo_platform_ticks_to_ns, which is valid in the process that took them once an instance is initialized */
+uint64_t fifo_platform_get_ticks(void);
+uint64_t fifo_platform_ticks_to_ns(uint64_t ticks);
+/* CLOCK_REALTIME in nanoseconds */
+uint64_t fifo_platform_get_wall_time(void);
+/* CPU of the calling thread, it may change right after the call. the count includes the offline CPUs */
+unsigned fifo_platform_get_cpu(void);
+unsigned fifo_platform_get_cpu_count(void);
+/* allocate fifo->capacity bytes to fifo->buf and set fifo->buf_mirrored, on the node of fifo->numa_cpu if it can.
+ * with fifo->ring_path the port maps the file and points fifo->ring to its header */
+FifoErrCode fifo_platform_buf_alloc(fifo_t *fifo);
+void fifo_platform_buf_free(fifo_t *fifo);
+
+/* fifo_fmt.c, deferred formatting record: format pointer, argument count, types, then the packed arguments */
+size_t fifo_fmt_size(size_t count, const uint8_t *types, va_list args);
+void fifo_fmt_pack(char *dst, const char *format, size_t count, const uint8_t *types, va_list args);
+size_t fifo_fmt_expand(const char *rec, size_t size, char *out, size_t out_size);
+
+/* fifo_stats.c, the hooks compile out to nothing without FIFO_USING_STATS */
+#ifdef FIFO_USING_STATS
+FifoErrCode fifo_stats_init(fifo_t *fifo);
+void fifo_stats_deinit(fifo_t *fifo);
+uint64_t fifo_stats_now(void);
+/* a push ends, start is the fifo_stats_now at its beginning, 0: no duration */
+void fifo_stats_push(fifo_t *fifo, FifoErrCode result, size_t size, uint64_t start);
+/* the ring buffer used size after a reservation */
+void fifo_stats_used(fifo_t *fifo, size_t used);
+void fifo_stats_lock_wait(fifo_t *fifo, uint64_t start);
+void fifo_stats_commit_wait(fifo_t *fifo, uint64_t start);
+void fifo_stats_wakeup(fifo_t *fifo);
+void fifo_stats_latency(fifo_t *fifo, const FifoRecord *records, size_t count);
+#else
+static inline FifoErrCode fifo_stats_init(fifo_t *fifo) { (void)fifo; return FIFO_NO_ERR; }
+static inline void fifo_stats_deinit(fifo_t *fifo) { (void)fifo; }
+static inline uint64_t fifo_stats_now(void) { return 0; }
+static inline void fifo_stats_push(fifo_t *fifo, FifoErrCode result, size_t size, uint64_t start) {
+    (void)fifo; (void)result; (void)size; (void)start;
+}
+static inline void fifo_stats_used(fifo_t *fifo, size_t used) { (void)fifo; (void)used; }
+static inline void fifo_stats_lock_wait(fifo_t *fifo, uint64_t start) { (void)fifo; (void)start; }
+static inline void fifo_stats_commit_wait(fifo_t *fifo, uint64_t start) { (void)fifo; (void)start; }
+static inline void fifo_stats_wakeup(fifo_t *fifo) { (void)fifo; }
+static inline void fifo_stats_latency(fifo_t *fifo, const FifoRecord *records, size_t count) {
+    (void)fifo; (void)records; (void)count;
+}
+#endif
+
+/* fifo.c, the port runs it as the output thread entry with the instance as argument */
+void async_output_task(void *arg);
+
+#endif /* __FIFO_DEF_H__ */
@@ -0,0 +1,338 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Deferred formatting, the arguments are packed by the producer and formatted by the output thread.
+ * Created on: 2026-10-17
+ */
+
+#include "fifo_def.h"
+#include <string.h>
+#include <stdio.h>
+
+/* max copied string argument size, the longer string is cut */
+#define FIFO_FMT_STR_MAX_SIZE                       1024
+/* max conversion specification size */
+#define FIFO_FMT_SPEC_MAX_SIZE                      32
+/* conversion specifiers, %n is not supported */
+#define FIFO_FMT_CONVERSIONS                        "diouxXeEfFgGaAcspn"
+
+/**
+ * packed size of a string argument: its size and the string with terminator
+ */
+static size_t fifo_fmt_str_size(const char *str) {
+    size_t len = str ? strlen(str) : strlen("(null)");
+
+    return sizeof(uint32_t) + (len < FIFO_FMT_STR_MAX_SIZE ? len : FIFO_FMT_STR_MAX_SIZE - 1) + 1;
+}
+
+/**
+ * packed size of the deferred formatting record
+ *
+ * @param count arguments count
+ * @param types argument types, FifoArgType
+ * @param args arguments, they are consumed
+ *
+ * @return record payload size
+ */
+size_t fifo_fmt_size(size_t count, const uint8_t *types, va_list args) {
+    size_t size = sizeof(const char *) + sizeof(uint8_t) + count, i;
+
+    for (i = 0; i < count; i++) {
+        switch (types[i]) {
+        case FIFO_ARG_LONG:
+            (void)va_arg(args, long);
+            size += sizeof(long);
+            break;
+        case FIFO_ARG_LLONG:
+            (void)va_arg(args, long long);
+            size += sizeof(long long);
+            break;
+        case FIFO_ARG_DOUBLE:
+            (void)va_arg(args, double);
+            size += sizeof(double);
+            break;
+        case FIFO_ARG_LDOUBLE:
+            (void)va_arg(args, long double);
+            size += sizeof(long double);
+            break;
+        case FIFO_ARG_STR:
+            size += fifo_fmt_str_size(va_arg(args, const char *));
+            break;
+        case FIFO_ARG_PTR:
+            (void)va_arg(args, void *);
+            size += sizeof(void *);
+            break;
+        default:
+            (void)va_arg(args, int);
+            size += sizeof(int);
+            break;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * pack the deferred formatting record, the arguments are stored unaligned
+ *
+ * @param dst record payload, its size is from fifo_fmt_size
+ * @param format format, it must stay valid until the record is output
+ * @param count arguments count
+ * @param types argument types, FifoArgType
+ * @param args arguments, they are consumed
+ */
+void fifo_fmt_pack(char *dst, const char *format, size_t count, const uint8_t *types, va_list args) {
+    const char *str;
+    uint32_t len;
+    size_t i;
+
+    memcpy(dst, &format, sizeof(format));
+    dst += sizeof(format);
+    *dst++ = (char)count;
+    memcpy(dst, types, count);
+    dst += count;
+
+#define FIFO_FMT_PACK(type)                                   \
+    do {                                                      \
+        type value = va_arg(args, type);                      \
+        memcpy(dst, &value, sizeof(value));                   \
+        dst += sizeof(value);                                 \
+    } while (0)
+
+    for (i = 0; i < count; i++) {
+        switch (types[i]) {
+        case FIFO_ARG_LONG:
+            FIFO_FMT_PACK(long);
+            break;
+        case FIFO_ARG_LLONG:
+            FIFO_FMT_PACK(long long);
+            break;
+        case FIFO_ARG_DOUBLE:
+            FIFO_FMT_PACK(double);
+            break;
+        case FIFO_ARG_LDOUBLE:
+            FIFO_FMT_PACK(long double);
+            break;
+        case FIFO_ARG_STR:
+            str = va_arg(args, const char *);
+            if (!str) {
+                str = "(null)";
+            }
+            len = (uint32_t)(fifo_fmt_str_size(str) - sizeof(uint32_t));
+            memcpy(dst, &len, sizeof(len));
+            dst += sizeof(len);
+            memcpy(dst, str, len - 1);
+            dst[len - 1] = '\0';
+            dst += len;
+            break;
+        case FIFO_ARG_PTR:
+            FIFO_FMT_PACK(void *);
+            break;
+        default:
+            FIFO_FMT_PACK(int);
+            break;
+        }
+    }
+
+#undef FIFO_FMT_PACK
+}
+
+/**
+ * read a packed argument
+ *
+ * @param args packed arguments, it is moved to the next one
+ * @param end end of the packed arguments
+ * @param value argument value
+ * @param size argument size
+ *
+ * @return false when the record is broken
+ */
+static bool fifo_fmt_read(const char **args, const char *end, void *value, size_t size) {
+    if ((size_t)(end - *args) < size) {
+        return false;
+    }
+    memcpy(value, *args, size);
+    *args += size;
+
+    return true;
+}
+
+/**
+ * format one packed argument with its conversion specification
+ *
+ * @param out output buffer
+ * @param size output buffer size
+ * @param spec conversion specification
+ * @param star values of the '*' width and precision
+ * @param nstar count of the '*'
+ * @param type argument type
+ * @param args packed arguments, it is moved to the next one
+ * @param end end of the packed arguments
+ *
+ * @return snprintf result, -1 when the record is broken
+ */
+static int fifo_fmt_arg(char *out, size_t size, const char *spec, const int *star, int nstar, uint8_t type,
+        const char **args, const char *end) {
+    uint32_t len;
+
+#define FIFO_FMT_ARG(value)                                                                 \
+    (nstar == 0 ? snprintf(out, size, spec, value)                                          \
+            : nstar == 1 ? snprintf(out, size, spec, star[0], value)                        \
+            : snprintf(out, size, spec, star[0], star[1], value))
+#define FIFO_FMT_CASE(type)                                                                 \
+    do {                                                                                    \
+        type value;                                                                         \
+        if (!fifo_fmt_read(args, end, &value, sizeof(value))) {                             \
+            return -1;                                                                      \
+        }                                                                                   \
+        return FIFO_FMT_ARG(value);                                                         \
+    } while (0)
+
+    switch (type) {
+    case FIFO_ARG_LONG:
+        FIFO_FMT_CASE(long);
+    case FIFO_ARG_LLONG:
+        FIFO_FMT_CASE(long long);
+    case FIFO_ARG_DOUBLE:
+        FIFO_FMT_CASE(double);
+    case FIFO_ARG_LDOUBLE:
+        FIFO_FMT_CASE(long double);
+    case FIFO_ARG_STR:
+        /* the packed string has its terminator */
+        if (!fifo_fmt_read(args, end, &len, sizeof(len)) || !len || (size_t)(end - *args) < len
+                || (*args)[len - 1] != '\0') {
+            return -1;
+        }
+        *args += len;
+        return FIFO_FMT_ARG(*args - len);
+    case FIFO_ARG_PTR:
+        FIFO_FMT_CASE(void *);
+    default:
+        FIFO_FMT_CASE(int);
+    }
+
+#undef FIFO_FMT_CASE
+#undef FIFO_FMT_ARG
+}
+
+/**
+ * read a packed argument as the int of '*' width or precision
+ */
+static bool fifo_fmt_read_int(const char **args, const char *end, uint8_t type, int *value) {
+    long long llong_value;
+    long long_value;
+
+    switch (type) {
+    case FIFO_ARG_INT:
+        return fifo_fmt_read(args, end, value, sizeof(int));
+    case FIFO_ARG_LONG:
+        if (!fifo_fmt_read(args, end, &long_value, sizeof(long_value))) {
+            return false;
+        }
+        *value = (int)long_value;
+        return true;
+    case FIFO_ARG_LLONG:
+        if (!fifo_fmt_read(args, end, &llong_value, sizeof(llong_value))) {
+            return false;
+        }
+        *value = (int)llong_value;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * format the deferred formatting record like snprintf
+ * @note a conversion without argument, a broken record or %n ends the output
+ *
+ * @param rec record payload
+ * @param size record payload size
+ * @param out output buffer
+ * @param out_size output buffer size, the output is terminated
+ *
+ * @return output size without terminator
+ */
+size_t fifo_fmt_expand(const char *rec, size_t size, char *out, size_t out_size) {
+    char spec[FIFO_FMT_SPEC_MAX_SIZE];
+    const char *format, *args, *end = rec + size;
+    const uint8_t *types;
+    size_t count, arg = 0, len = 0, spec_len;
+    int star[2], nstar, result;
+
+    if (!out_size) {
+        return 0;
+    }
+    out[0] = '\0';
+    if (size < sizeof(format) + sizeof(uint8_t)) {
+        return 0;
+    }
+    memcpy(&format, rec, sizeof(format));
+    count = (uint8_t)rec[sizeof(format)];
+    types = (const uint8_t *)rec + sizeof(format) + sizeof(uint8_t);
+    args = (const char *)types + count;
+    if (args > end) {
+        return 0;
+    }
+
+    while (*format && len < out_size - 1) {
+        if (*format != '%') {
+            out[len++] = *format++;
+            continue;
+        }
+        if (format[1] == '%') {
+            out[len++] = '%';
+            format += 2;
+            continue;
+        }
+        /* flags, width, precision and length, then the conversion */
+        spec_len = 0;
+        nstar = 0;
+        spec[spec_len++] = *format++;
+        while (*format && !strchr(FIFO_FMT_CONVERSIONS, *format) && spec_len < FIFO_FMT_SPEC_MAX_SIZE - 2) {
+            if (*format == '*') {
+                if (nstar == 2 || arg >= count || !fifo_fmt_read_int(&args, end, types[arg++], &star[nstar])) {
+                    goto __exit;
+                }
+                nstar++;
+            }
+            spec[spec_len++] = *format++;
+        }
+        if (!*format || *format == 'n' || !strchr(FIFO_FMT_CONVERSIONS, *format) || arg >= count) {
+            goto __exit;
+        }
+        spec[spec_len++] = *format++;
+        spec[spec_len] = '\0';
+        result = fifo_fmt_arg(out + len, out_size - len, spec, star, nstar, types[arg++], &args, end);
+        if (result < 0) {
+            goto __exit;
+        }
+        len += (size_t)result < out_size - len ? (size_t)result : out_size - len - 1;
+    }
+
+__exit:
+    out[len] = '\0';
+
+    return len;
+}
@@ -0,0 +1,181 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Instance group. The stream is sharded over several instances by producer thread, CPU or key,
+ *           every shard is output by its own thread, or by the thread of the first shard in sequence or
+ *           time order.
+ * Created on: 2026-10-17
+ */
+
+#include "fifo_def.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* thread id for the shard choice, 0: not assigned */
+static FIFO_THREAD_LOCAL unsigned s_thread_id;
+static atomic_uint s_thread_next = 1;
+
+/**
+ * create an instance group, all output threads start running
+ *
+ * @param cfg configuration
+ *
+ * @return group, NULL when the configuration is not supported or no memory
+ */
+fifo_group_t *fifo_group_create(const FifoGroupCfg *cfg) {
+    FifoCfg shard_cfg = cfg->shard;
+    fifo_group_t *group;
+    size_t i, shards = cfg->shards;
+
+    if (!shards && cfg->shard_by == FIFO_SHARD_CPU) {
+        shards = fifo_platform_get_cpu_count();
+        shards = shards < FIFO_GROUP_SHARDS_MAX ? shards : FIFO_GROUP_SHARDS_MAX;
+    }
+    if (!shards || shards > FIFO_GROUP_SHARDS_MAX || shard_cfg.ring_path || shard_cfg.shm_name) {
+        return NULL;
+    }
+    if (cfg->order != FIFO_ORDER_NONE) {
+        /* the merge needs a key on every record, and no gap in the sequence numbers */
+        if (!(shard_cfg.flags & FIFO_FLAG_FRAMED) || shard_cfg.overflow == FIFO_OVERFLOW_OVERWRITE
+                || shard_cfg.overflow == FIFO_OVERFLOW_SPILL) {
+            return NULL;
+        }
+        shard_cfg.flags |= cfg->order == FIFO_ORDER_SEQ ? FIFO_FLAG_SEQ : FIFO_FLAG_TIMESTAMP;
+    } else if (shard_cfg.sink && shards > 1) {
+        /* a sink is called by one thread */
+        return NULL;
+    }
+
+    group = calloc(1, sizeof(fifo_group_t));
+    if (!group) {
+        return NULL;
+    }
+    atomic_init(&group->seq, 0);
+    group->order = cfg->order;
+    group->shard_by = cfg->shard_by;
+    group->count = shards;
+    if (group->order != FIFO_ORDER_NONE && !(group->batches = calloc(group->count, sizeof(FifoMergeBatch)))) {
+        free(group);
+        return NULL;
+    }
+    /* the first shard is the last one, its output thread merges the others */
+    for (i = group->count; i-- > 0;) {
+        if (!fifo_create_shard(&shard_cfg, group, i, NULL)) {
+            fifo_group_destroy(group);
+            return NULL;
+        }
+    }
+
+    return group;
+}
+
+/**
+ * destroy an instance group, the output threads output the remaining log before exit
+ *
+ * @param group group
+ */
+void fifo_group_destroy(fifo_group_t *group) {
+    size_t i;
+
+    if (!group) {
+        return;
+    }
+    /* no shard takes new log, the merging thread then drains all of them */
+    for (i = 0; i < group->count; i++) {
+        if (group->shards[i]) {
+            group->shards[i]->output_enabled = false;
+        }
+    }
+    for (i = 0; i < group->count; i++) {
+        fifo_destroy(group->shards[i]);
+    }
+    free(group->batches);
+    free(group);
+}
+
+/**
+ * shard of the calling thread. with FIFO_SHARD_THREAD a thread keeps its shard, the threads are spread over
+ * the shards in order of their first use, so up to the shards count of threads do not share a ring buffer.
+ * with FIFO_SHARD_CPU it is the shard of the current CPU
+ *
+ * @param group group
+ *
+ * @return shard instance, every instance function works on it
+ */
+fifo_t *fifo_group_shard(fifo_group_t *group) {
+    if (group->shard_by == FIFO_SHARD_CPU) {
+        return group->shards[fifo_platform_get_cpu() % group->count];
+    }
+    if (!s_thread_id) {
+        s_thread_id = atomic_fetch_add_explicit(&s_thread_next, 1, memory_order_relaxed);
+    }
+
+    return group->shards[(s_thread_id - 1) % group->count];
+}
+
+/**
+ * shard of a key, the log of one key stays in order with FIFO_ORDER_NONE too
+ *
+ * @param group group
+ * @param key key like a connection or a session id
+ *
+ * @return shard instance
+ */
+fifo_t *fifo_group_shard_key(fifo_group_t *group, uint64_t key) {
+    return group->shards[key % group->count];
+}
+
+/**
+ * output RAW format log to the shard of the calling thread
+ *
+ * @param group group
+ * @param format output format
+ * @param ... args
+ *
+ * @return result
+ */
+FifoErrCode fifo_group_push(fifo_group_t *group, const char *format, ...) {
+    FifoErrCode result;
+    va_list args;
+
+    va_start(args, format);
+    result = fifo_vpush_h(fifo_group_shard(group), format, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ * write data to the shard of the calling thread
+ *
+ * @param group group
+ * @param buf data
+ * @param size data size
+ *
+ * @return result
+ */
+FifoErrCode fifo_group_write(fifo_group_t *group, const char *buf, size_t size) {
+    return fifo_write_h(fifo_group_shard(group), buf, size);
+}
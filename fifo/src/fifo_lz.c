@@ -0,0 +1,247 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: LZ77 block codec in the LZ4 block style. A sequence is a token byte with the literal length
+ *           and the match length, the literals, and a 16 bit little endian match offset. A length of 15
+ *           in the token continues in bytes of 255. The last sequence has literals only.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo_lz.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* shortest match, the match length in the token is counted from it */
+#define LZ_MIN_MATCH                 4
+/* the last literals, a match ends before them so the decoder never reads past a match */
+#define LZ_LAST_LITERALS             5
+/* no match starts in the last bytes */
+#define LZ_MF_LIMIT                  12
+#define LZ_MAX_OFFSET                65535
+/* the search step grows every 2^LZ_SKIP_TRIGGER misses, incompressible data is passed over fast */
+#define LZ_SKIP_TRIGGER              6
+
+static inline uint32_t lz_read32(const uint8_t *ptr) {
+    uint32_t value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+    return value;
+}
+
+static inline uint32_t lz_hash(uint32_t value) {
+    return (value * 2654435761U) >> (32 - FIFO_LZ_HASH_BITS);
+}
+
+/**
+ * write a length over the 4 bit token field
+ */
+static inline uint8_t *lz_write_length(uint8_t *op, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)length;
+
+    return op;
+}
+
+/**
+ * write a sequence
+ *
+ * @param match match length, 0: the last sequence
+ *
+ * @return the end of the output, NULL: no space
+ */
+static uint8_t *lz_write_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literals, size_t count,
+        size_t offset, size_t match) {
+    uint8_t *token = op;
+
+    /* the token, the lengths, the literals and the offset */
+    if ((size_t)(oend - op) < count + count / 255 + match / 255 + 5) {
+        return NULL;
+    }
+    op++;
+    if (count >= 15) {
+        *token = 15 << 4;
+        op = lz_write_length(op, count - 15);
+    } else {
+        *token = (uint8_t)(count << 4);
+    }
+    memcpy(op, literals, count);
+    op += count;
+    if (!match) {
+        return op;
+    }
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    match -= LZ_MIN_MATCH;
+    if (match >= 15) {
+        *token |= 15;
+        op = lz_write_length(op, match - 15);
+    } else {
+        *token |= (uint8_t)match;
+    }
+
+    return op;
+}
+
+/**
+ * compress a block
+ *
+ * @param src data
+ * @param size data size
+ * @param dst output
+ * @param capacity output size, FIFO_LZ_BOUND(size) is always enough
+ * @param work FIFO_LZ_WORK_SIZE bytes
+ *
+ * @return compressed size, 0: no space in the output
+ */
+size_t fifo_lz_compress(const void *src, size_t size, void *dst, size_t capacity, void *work) {
+    const uint8_t *base = src, *ip = base, *anchor = base, *end = base + size, *ref;
+    const uint8_t *mf_limit = size > LZ_MF_LIMIT ? end - LZ_MF_LIMIT : base, *match_limit = end;
+    uint8_t *op = dst, *oend = op + capacity;
+    uint32_t *table = work;
+    size_t match, misses = 0;
+    uint32_t hash;
+
+    memset(table, 0, FIFO_LZ_WORK_SIZE);
+    if (mf_limit > base) {
+        match_limit = end - LZ_LAST_LITERALS;
+        /* the table keeps the last position of every hash, the first position is 0 so it is never empty */
+        for (ip++; ip < mf_limit;) {
+            hash = lz_hash(lz_read32(ip));
+            ref = base + table[hash];
+            table[hash] = (uint32_t)(ip - base);
+            if (ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != lz_read32(ip)) {
+                ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+            /* the match may start before the hashed position */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            for (match = LZ_MIN_MATCH; ip + match < match_limit && ip[match] == ref[match]; match++);
+            op = lz_write_sequence(op, oend, anchor, ip - anchor, ip - ref, match);
+            if (!op) {
+                return 0;
+            }
+            ip += match;
+            anchor = ip;
+            /* the position before the next search is hashed too, it finds the repeats of short lines */
+            if (ip - 2 > base && ip < mf_limit) {
+                table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+            }
+        }
+    }
+
+    op = lz_write_sequence(op, oend, anchor, end - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+
+    return op - (uint8_t *)dst;
+}
+
+/**
+ * read a length over the 4 bit token field
+ *
+ * @return false: the input ends
+ */
+static inline bool lz_read_length(const uint8_t **ip, const uint8_t *iend, size_t *length) {
+    uint8_t byte;
+
+    do {
+        if (*ip >= iend) {
+            return false;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/**
+ * decompress a block, the input is checked so a broken block can not write out of the output
+ *
+ * @param src compressed data
+ * @param size compressed size
+ * @param dst output
+ * @param capacity output size
+ *
+ * @return decompressed size, 0: broken block or no space in the output
+ */
+size_t fifo_lz_decompress(const void *src, size_t size, void *dst, size_t capacity) {
+    const uint8_t *ip = src, *iend = ip + size, *ref;
+    uint8_t *op = dst, *oend = op + capacity;
+    size_t count, offset, match, i;
+    uint8_t token;
+
+    while (ip < iend) {
+        token = *ip++;
+        count = token >> 4;
+        if (count == 15 && !lz_read_length(&ip, iend, &count)) {
+            return 0;
+        }
+        if (count > (size_t)(iend - ip) || count > (size_t)(oend - op)) {
+            return 0;
+        }
+        memcpy(op, ip, count);
+        ip += count;
+        op += count;
+        if (ip == iend) {
+            /* the last sequence */
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return 0;
+        }
+        offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        match = token & 15;
+        if (match == 15 && !lz_read_length(&ip, iend, &match)) {
+            return 0;
+        }
+        match += LZ_MIN_MATCH;
+        if (!offset || offset > (size_t)(op - (uint8_t *)dst) || match > (size_t)(oend - op)) {
+            return 0;
+        }
+        ref = op - offset;
+        if (offset >= match) {
+            memcpy(op, ref, match);
+        } else {
+            /* the match repeats its own output */
+            for (i = 0; i < match; i++) {
+                op[i] = ref[i];
+            }
+        }
+        op += match;
+    }
+
+    return op - (uint8_t *)dst;
+}
@@ -0,0 +1,734 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: File sink for linux. The batches are written straight from the ring buffer with io_uring,
+ *           several writes in flight, and the space is released when they complete. Without io_uring
+ *           every batch is written by a synchronous writev.
+ * Created on: 2026-10-17
+ */
+
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define FIFO_SINK_USING_URING
+#endif
+#endif
+
+/* writes in flight by default */
+#define FIFO_SINK_QUEUE_DEPTH          8
+/* O_DIRECT alignment of the file offset, the size and the buffer */
+#define FIFO_SINK_DIRECT_ALIGN         4096
+/* O_DIRECT staging buffer size of a write */
+#define FIFO_SINK_DIRECT_CHUNK         (256 * 1024)
+/* the CQE of the linked fsync has this bit in its user data */
+#define FIFO_SINK_FSYNC_TAG            1
+
+/* a write in flight */
+typedef struct {
+    struct iovec iov[FIFO_POP_RECORDS_MAX];
+    int iovcnt;
+    /* write size and file offset */
+    size_t size;
+    uint64_t offset;
+    /* ring buffer space released after the write completes, and its instance */
+    size_t release;
+    fifo_t *fifo;
+    /* CQEs not arrived yet, the write and the linked fsync */
+    int pending;
+    /* O_DIRECT staging buffer */
+    char *stage;
+} FifoSinkSlot;
+
+typedef struct {
+    /* it is the first member, so the sink pointer is the file sink pointer */
+    FifoSink sink;
+    FifoFileSinkCfg cfg;
+    char *path;
+    int fd;
+    /* logical file size, the next write goes there */
+    uint64_t file_size;
+    uint64_t open_time;
+    uint64_t sync_time;
+    /* suffix of the next rotated file */
+    unsigned rotate_seq;
+    /* O_DIRECT bytes after the last aligned block, they are written again with the next block */
+    char *carry;
+    size_t carry_size;
+    /* writes in flight in submission order, the space is released in this order */
+    FifoSinkSlot *slots;
+    uint32_t depth;
+    uint32_t head;
+    uint32_t count;
+    /* failed writes and fsyncs */
+    uint64_t errors;
+#ifdef FIFO_SINK_USING_URING
+    int ring_fd;
+    void *sq_ptr;
+    size_t sq_map_size;
+    void *cq_ptr;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_map_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+#endif
+} FifoFileSink;
+
+static uint64_t sink_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * write the regions at the offset, a short write is continued
+ *
+ * @param skip bytes of the regions already written
+ *
+ * @return 0: success
+ */
+static int sink_pwritev_all(int fd, const struct iovec *iov, int iovcnt, uint64_t offset, size_t skip) {
+    struct iovec rest[FIFO_POP_RECORDS_MAX];
+    size_t left;
+    ssize_t written;
+    int i, count;
+
+    for (;;) {
+        /* the regions after the written bytes */
+        count = 0;
+        left = skip;
+        for (i = 0; i < iovcnt; i++) {
+            if (left >= iov[i].iov_len) {
+                left -= iov[i].iov_len;
+                continue;
+            }
+            rest[count].iov_base = (char *)iov[i].iov_base + left;
+            rest[count].iov_len = iov[i].iov_len - left;
+            left = 0;
+            count++;
+        }
+        if (!count) {
+            return 0;
+        }
+        written = pwritev(fd, rest, count, (off_t)(offset + skip));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        skip += written;
+    }
+}
+
+#ifdef FIFO_SINK_USING_URING
+/**
+ * set up the io_uring with raw system calls, no library is needed
+ *
+ * @return 0: success
+ */
+static int sink_uring_init(FifoFileSink *s) {
+    struct io_uring_params params;
+    char *sq, *cq;
+
+    memset(&params, 0, sizeof(params));
+    s->ring_fd = (int)syscall(__NR_io_uring_setup, s->depth * 2, &params);
+    if (s->ring_fd < 0) {
+        return -1;
+    }
+
+    s->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    s->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        s->sq_map_size = s->cq_map_size = s->sq_map_size > s->cq_map_size ? s->sq_map_size : s->cq_map_size;
+    }
+    s->sq_ptr = mmap(NULL, s->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring_fd,
+            IORING_OFF_SQ_RING);
+    if (s->sq_ptr == MAP_FAILED) {
+        goto __fail;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        s->cq_ptr = s->sq_ptr;
+    } else {
+        s->cq_ptr = mmap(NULL, s->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring_fd,
+                IORING_OFF_CQ_RING);
+        if (s->cq_ptr == MAP_FAILED) {
+            munmap(s->sq_ptr, s->sq_map_size);
+            goto __fail;
+        }
+    }
+    s->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    s->sqes = mmap(NULL, s->sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s->ring_fd,
+            IORING_OFF_SQES);
+    if (s->sqes == MAP_FAILED) {
+        if (s->cq_ptr != s->sq_ptr) {
+            munmap(s->cq_ptr, s->cq_map_size);
+        }
+        munmap(s->sq_ptr, s->sq_map_size);
+        goto __fail;
+    }
+
+    sq = s->sq_ptr;
+    cq = s->cq_ptr;
+    s->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    s->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    s->sq_array = (unsigned *)(sq + params.sq_off.array);
+    s->cq_head = (unsigned *)(cq + params.cq_off.head);
+    s->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    s->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    s->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+
+__fail:
+    close(s->ring_fd);
+    s->ring_fd = -1;
+    return -1;
+}
+
+static void sink_uring_deinit(FifoFileSink *s) {
+    if (s->ring_fd < 0) {
+        return;
+    }
+    munmap(s->sqes, s->sqes_map_size);
+    if (s->cq_ptr != s->sq_ptr) {
+        munmap(s->cq_ptr, s->cq_map_size);
+    }
+    munmap(s->sq_ptr, s->sq_map_size);
+    close(s->ring_fd);
+    s->ring_fd = -1;
+}
+
+/**
+ * queue a SQE, it is submitted by sink_uring_submit
+ */
+static struct io_uring_sqe *sink_uring_get_sqe(FifoFileSink *s, unsigned *tail) {
+    unsigned index = *tail & *s->sq_mask;
+    struct io_uring_sqe *sqe = &s->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    s->sq_array[index] = index;
+    (*tail)++;
+
+    return sqe;
+}
+
+/**
+ * submit the write of a slot, the linked fsync follows it for FIFO_FSYNC_ALWAYS
+ *
+ * @return 0: success
+ */
+static int sink_uring_submit(FifoFileSink *s, uint32_t slot_index) {
+    FifoSinkSlot *slot = &s->slots[slot_index];
+    unsigned tail = *s->sq_tail, submit;
+    struct io_uring_sqe *sqe;
+    long result;
+
+    sqe = sink_uring_get_sqe(s, &tail);
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = s->fd;
+    sqe->addr = (uintptr_t)slot->iov;
+    sqe->len = (unsigned)slot->iovcnt;
+    sqe->off = slot->offset;
+    sqe->user_data = (uint64_t)slot_index << 1;
+    slot->pending = 1;
+    if (s->cfg.fsync == FIFO_FSYNC_ALWAYS) {
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe = sink_uring_get_sqe(s, &tail);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = s->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = ((uint64_t)slot_index << 1) | FIFO_SINK_FSYNC_TAG;
+        slot->pending = 2;
+    }
+    submit = tail - *s->sq_tail;
+    /* the SQEs are visible to the kernel before the tail */
+    __atomic_store_n(s->sq_tail, tail, __ATOMIC_RELEASE);
+
+    do {
+        result = syscall(__NR_io_uring_enter, s->ring_fd, submit, 0, 0, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        /* take the SQEs back, the write is done synchronously */
+        __atomic_store_n(s->sq_tail, tail - submit, __ATOMIC_RELEASE);
+        slot->pending = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * reap the arrived CQEs, wait for one when asked
+ */
+static void sink_uring_reap(FifoFileSink *s, bool wait) {
+    unsigned head, tail;
+    struct io_uring_cqe *cqe;
+    FifoSinkSlot *slot;
+
+    if (wait) {
+        while (syscall(__NR_io_uring_enter, s->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+                && errno == EINTR);
+    }
+
+    head = *s->cq_head;
+    tail = __atomic_load_n(s->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        cqe = &s->cqes[head & *s->cq_mask];
+        slot = &s->slots[cqe->user_data >> 1];
+        if (cqe->user_data & FIFO_SINK_FSYNC_TAG) {
+            /* a short write cancels the linked fsync, it is done after the write is finished */
+            if (cqe->res == -ECANCELED || cqe->res < 0) {
+                if (fdatasync(s->fd) != 0) {
+                    s->errors++;
+                }
+            }
+        } else if (cqe->res < 0 || (size_t)cqe->res < slot->size) {
+            if (sink_pwritev_all(s->fd, slot->iov, slot->iovcnt, slot->offset,
+                    cqe->res < 0 ? 0 : (size_t)cqe->res) != 0) {
+                s->errors++;
+            }
+        }
+        slot->pending--;
+    }
+    __atomic_store_n(s->cq_head, head, __ATOMIC_RELEASE);
+}
+#endif /* FIFO_SINK_USING_URING */
+
+/**
+ * release the space of the completed writes in submission order
+ */
+static void sink_release_done(FifoFileSink *s) {
+    FifoSinkSlot *slot;
+
+    while (s->count) {
+        slot = &s->slots[s->head];
+        if (slot->pending) {
+            break;
+        }
+        if (slot->release) {
+            fifo_release_h(slot->fifo, slot->release);
+        }
+        s->head = (s->head + 1) % s->depth;
+        s->count--;
+    }
+}
+
+/**
+ * wait until no more than keep writes are in flight
+ */
+static void sink_wait(FifoFileSink *s, uint32_t keep) {
+    sink_release_done(s);
+#ifdef FIFO_SINK_USING_URING
+    while (s->count > keep) {
+        sink_uring_reap(s, true);
+        sink_release_done(s);
+    }
+#endif
+}
+
+/**
+ * write the O_DIRECT carry padded to a whole block, so it is in the file before the next block.
+ * the padding is cut off, the next write of the block writes it again.
+ */
+static void sink_flush_carry(FifoFileSink *s) {
+    ssize_t written;
+
+    if (!s->cfg.direct || !s->carry_size) {
+        return;
+    }
+    memset(s->carry + s->carry_size, 0, FIFO_SINK_DIRECT_ALIGN - s->carry_size);
+    do {
+        written = pwrite(s->fd, s->carry, FIFO_SINK_DIRECT_ALIGN, (off_t)(s->file_size - s->carry_size));
+    } while (written < 0 && errno == EINTR);
+    if (written != FIFO_SINK_DIRECT_ALIGN || ftruncate(s->fd, (off_t)s->file_size) != 0) {
+        s->errors++;
+    }
+}
+
+static void sink_sync(FifoFileSink *s) {
+    if (fdatasync(s->fd) != 0) {
+        s->errors++;
+    }
+    s->sync_time = sink_now();
+}
+
+/**
+ * open the output file for appending
+ *
+ * @return 0: success
+ */
+static int sink_open(FifoFileSink *s) {
+    struct stat st;
+    ssize_t size;
+    int fd;
+
+    fd = open(s->path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        goto __fail;
+    }
+    s->file_size = st.st_size;
+    s->carry_size = 0;
+    if (s->cfg.direct) {
+        /* the partial last block is read back as the carry, then the file is opened again without cache */
+        s->carry_size = s->file_size % FIFO_SINK_DIRECT_ALIGN;
+        if (s->carry_size) {
+            close(fd);
+            fd = open(s->path, O_RDONLY | O_CLOEXEC);
+            size = fd < 0 ? -1 : pread(fd, s->carry, s->carry_size, (off_t)(s->file_size - s->carry_size));
+            if (size != (ssize_t)s->carry_size) {
+                goto __fail;
+            }
+        }
+        close(fd);
+        fd = open(s->path, O_WRONLY | O_CLOEXEC | O_DIRECT);
+        if (fd < 0) {
+            goto __fail;
+        }
+    }
+    s->fd = fd;
+    s->open_time = s->sync_time = sink_now();
+
+    return 0;
+
+__fail:
+    if (fd >= 0) {
+        close(fd);
+    }
+    s->fd = -1;
+    return -1;
+}
+
+/**
+ * finish the current file, all writes are completed
+ */
+static void sink_close(FifoFileSink *s) {
+    if (s->fd < 0) {
+        return;
+    }
+    sink_flush_carry(s);
+    if (s->cfg.fsync != FIFO_FSYNC_NONE) {
+        sink_sync(s);
+    }
+    close(s->fd);
+    s->fd = -1;
+}
+
+/**
+ * rotate the file when it is large or old enough, a batch is never split over two files
+ */
+static void sink_rotate(FifoFileSink *s) {
+    char *name;
+    struct stat st;
+
+    if (!(s->cfg.rotate_size && s->file_size >= s->cfg.rotate_size)
+            && !(s->cfg.rotate_ms && sink_now() - s->open_time >= (uint64_t)s->cfg.rotate_ms * 1000000)) {
+        return;
+    }
+    /* nothing empty is rotated */
+    if (!s->file_size) {
+        s->open_time = sink_now();
+        return;
+    }
+
+    sink_wait(s, 0);
+    sink_close(s);
+    name = malloc(strlen(s->path) + 16);
+    if (name) {
+        /* the suffixes of the earlier runs are kept */
+        do {
+            sprintf(name, "%s.%u", s->path, ++s->rotate_seq);
+        } while (stat(name, &st) == 0);
+        if (rename(s->path, name) != 0) {
+            s->errors++;
+        }
+        free(name);
+    }
+    if (sink_open(s) != 0) {
+        s->errors++;
+    }
+}
+
+/**
+ * stage the data in the O_DIRECT buffers, whole blocks are written and the rest is carried
+ */
+static void sink_write_direct(FifoFileSink *s, const struct iovec *iov, int iovcnt) {
+    FifoSinkSlot *slot = NULL;
+    size_t used = 0, copy, done, aligned;
+    int i;
+
+    for (i = 0; i <= iovcnt; i++) {
+        done = 0;
+        /* one more round after the regions submits the last stage */
+        while (i == iovcnt ? slot != NULL : done < iov[i].iov_len) {
+            if (!slot) {
+                sink_wait(s, s->depth - 1);
+                slot = &s->slots[(s->head + s->count) % s->depth];
+                memcpy(slot->stage, s->carry, s->carry_size);
+                used = s->carry_size;
+            }
+            if (i < iovcnt) {
+                copy = iov[i].iov_len - done;
+                copy = copy < FIFO_SINK_DIRECT_CHUNK - used ? copy : FIFO_SINK_DIRECT_CHUNK - used;
+                memcpy(slot->stage + used, (const char *)iov[i].iov_base + done, copy);
+                used += copy;
+                done += copy;
+                s->file_size += copy;
+                if (used < FIFO_SINK_DIRECT_CHUNK) {
+                    continue;
+                }
+            }
+            /* the whole blocks are written, the rest is carried to the next stage */
+            aligned = used & ~(size_t)(FIFO_SINK_DIRECT_ALIGN - 1);
+            s->carry_size = used - aligned;
+            memcpy(s->carry, slot->stage + aligned, s->carry_size);
+            if (aligned) {
+                slot->iov[0].iov_base = slot->stage;
+                slot->iov[0].iov_len = aligned;
+                slot->iovcnt = 1;
+                slot->size = aligned;
+                slot->offset = s->file_size - s->carry_size - aligned;
+                slot->release = 0;
+                slot->pending = 0;
+#ifdef FIFO_SINK_USING_URING
+                if (s->ring_fd >= 0 && sink_uring_submit(s, (s->head + s->count) % s->depth) == 0) {
+                    s->count++;
+                    slot = NULL;
+                    continue;
+                }
+#endif
+                if (sink_pwritev_all(s->fd, slot->iov, 1, slot->offset, 0) != 0) {
+                    s->errors++;
+                }
+                if (s->cfg.fsync == FIFO_FSYNC_ALWAYS) {
+                    sink_sync(s);
+                }
+            }
+            slot = NULL;
+        }
+    }
+}
+
+/**
+ * write a batch from the ring buffer
+ */
+static void sink_write(FifoSink *sink, fifo_t *fifo, const struct iovec *iov, int iovcnt, size_t release,
+        bool in_ring) {
+    FifoFileSink *s = (FifoFileSink *)sink;
+    FifoSinkSlot *slot;
+    size_t size = 0;
+    int i;
+
+    sink_rotate(s);
+    if (s->fd < 0 && sink_open(s) != 0) {
+        /* no file, the data is lost */
+        s->errors++;
+        sink_wait(s, 0);
+        fifo_release_h(fifo, release);
+        return;
+    }
+
+    if (s->cfg.direct) {
+        /* the data is staged, the space is free at once */
+        sink_write_direct(s, iov, iovcnt);
+        sink_release_done(s);
+        fifo_release_h(fifo, release);
+    } else {
+        for (i = 0; i < iovcnt; i++) {
+            size += iov[i].iov_len;
+        }
+        sink_wait(s, s->depth - 1);
+        slot = &s->slots[(s->head + s->count) % s->depth];
+        memcpy(slot->iov, iov, sizeof(struct iovec) * iovcnt);
+        slot->iovcnt = iovcnt;
+        slot->size = size;
+        slot->offset = s->file_size;
+        slot->release = release;
+        slot->fifo = fifo;
+        slot->pending = 0;
+        s->file_size += size;
+#ifdef FIFO_SINK_USING_URING
+        if (size && s->ring_fd >= 0 && sink_uring_submit(s, (s->head + s->count) % s->depth) == 0) {
+            /* a padding batch only waits for the earlier writes */
+        } else
+#endif
+        if (size) {
+            if (sink_pwritev_all(s->fd, slot->iov, slot->iovcnt, slot->offset, 0) != 0) {
+                s->errors++;
+            }
+            if (s->cfg.fsync == FIFO_FSYNC_ALWAYS) {
+                sink_sync(s);
+            }
+        }
+        s->count++;
+        sink_release_done(s);
+    }
+
+    /* the buffer of the output thread is reused after return */
+    if (!in_ring) {
+        sink_wait(s, 0);
+    }
+    if (s->cfg.fsync == FIFO_FSYNC_INTERVAL && sink_now() - s->sync_time >= (uint64_t)s->cfg.fsync_ms * 1000000) {
+        sink_sync(s);
+    }
+}
+
+/**
+ * the output thread is idle, complete every write and put the carry in the file
+ */
+static uint32_t sink_flush(FifoSink *sink, fifo_t *fifo, bool idle) {
+    FifoFileSink *s = (FifoFileSink *)sink;
+
+    (void)fifo;
+    (void)idle;
+    sink_wait(s, 0);
+    if (s->fd < 0) {
+        return 0;
+    }
+    sink_flush_carry(s);
+    if (s->cfg.fsync == FIFO_FSYNC_INTERVAL && sink_now() - s->sync_time >= (uint64_t)s->cfg.fsync_ms * 1000000) {
+        sink_sync(s);
+    }
+
+    return 0;
+}
+
+/**
+ * create a file sink, pass it to FifoCfg.sink. it is destroyed after the instance.
+ *
+ * @param cfg configuration
+ *
+ * @return sink, NULL when the file can not be opened or no memory
+ */
+FifoSink *fifo_file_sink_create(const FifoFileSinkCfg *cfg) {
+    FifoFileSink *s;
+    uint32_t i;
+
+    if (!cfg->path || !(s = calloc(1, sizeof(FifoFileSink)))) {
+        return NULL;
+    }
+    s->sink.write = sink_write;
+    s->sink.flush = sink_flush;
+    s->cfg = *cfg;
+    s->fd = -1;
+    s->depth = cfg->queue_depth ? cfg->queue_depth : FIFO_SINK_QUEUE_DEPTH;
+    s->path = strdup(cfg->path);
+    s->slots = calloc(s->depth, sizeof(FifoSinkSlot));
+#ifdef FIFO_SINK_USING_URING
+    s->ring_fd = -1;
+#endif
+    if (!s->path || !s->slots) {
+        goto __fail;
+    }
+    if (cfg->direct) {
+        if (posix_memalign((void **)&s->carry, FIFO_SINK_DIRECT_ALIGN, FIFO_SINK_DIRECT_ALIGN) != 0) {
+            s->carry = NULL;
+            goto __fail;
+        }
+        for (i = 0; i < s->depth; i++) {
+            if (posix_memalign((void **)&s->slots[i].stage, FIFO_SINK_DIRECT_ALIGN,
+                    FIFO_SINK_DIRECT_CHUNK + FIFO_SINK_DIRECT_ALIGN) != 0) {
+                s->slots[i].stage = NULL;
+                goto __fail;
+            }
+        }
+    }
+    if (sink_open(s) != 0) {
+        goto __fail;
+    }
+#ifdef FIFO_SINK_USING_URING
+    /* the kernel may have no io_uring or forbid it, then the writes are synchronous */
+    if (!cfg->no_uring) {
+        sink_uring_init(s);
+    }
+#endif
+
+    return &s->sink;
+
+__fail:
+    fifo_file_sink_destroy(&s->sink);
+    return NULL;
+}
+
+/**
+ * destroy a file sink, the instance using it is destroyed before
+ *
+ * @param sink sink
+ */
+void fifo_file_sink_destroy(FifoSink *sink) {
+    FifoFileSink *s = (FifoFileSink *)sink;
+    uint32_t i;
+
+    if (!s) {
+        return;
+    }
+    /* fifo_destroy has flushed the writes */
+    sink_close(s);
+#ifdef FIFO_SINK_USING_URING
+    sink_uring_deinit(s);
+#endif
+    for (i = 0; s->slots && i < s->depth; i++) {
+        free(s->slots[i].stage);
+    }
+    free(s->slots);
+    free(s->carry);
+    free(s->path);
+    free(s);
+}
+
+/**
+ * failed writes and fsyncs of a file sink, the data of a failed write is lost
+ *
+ * @param sink sink
+ *
+ * @return errors count
+ */
+uint64_t fifo_file_sink_get_errors(FifoSink *sink) {
+    return ((FifoFileSink *)sink)->errors;
+}
+
+#endif
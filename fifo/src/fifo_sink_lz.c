@@ -0,0 +1,192 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Compression sink. It runs on the output thread only, it copies the batches into blocks,
+ *           compresses every full block with the in-tree LZ codec and writes it framed to the next sink.
+ *           A block is also closed when the output thread goes idle, so the latency stays bounded.
+ * Created on: 2026-10-17
+ */
+
+#include "fifo_def.h"
+#include <fifo_lz.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    /* it is the first member, so the sink pointer is the compression sink pointer */
+    FifoSink sink;
+    FifoSink *next;
+    /* raw data of the open block */
+    char *raw;
+    size_t block_size;
+    size_t used;
+    /* time of the first data in the open block, and how long an idle output thread keeps it */
+    uint64_t block_time;
+    uint64_t hold_ns;
+    /* block header and compressed payload */
+    char *out;
+    /* compressor hash table */
+    void *work;
+    FifoLzSinkStats stats;
+} FifoLzSink;
+
+/**
+ * compress the open block and pass it to the next sink
+ */
+static void lz_sink_emit(FifoLzSink *s, fifo_t *fifo) {
+    FifoLzBlockHdr *hdr = (FifoLzBlockHdr *)s->out;
+    struct iovec iov;
+    size_t size;
+
+    if (!s->used) {
+        return;
+    }
+    size = fifo_lz_compress(s->raw, s->used, s->out + sizeof(FifoLzBlockHdr), FIFO_LZ_BOUND(s->block_size),
+            s->work);
+    hdr->magic = FIFO_LZ_MAGIC;
+    hdr->flags = 0;
+    hdr->raw_size = (uint32_t)s->used;
+    if (!size || size >= s->used) {
+        /* incompressible, the reader copies it */
+        hdr->flags = FIFO_LZ_BLOCK_RAW;
+        memcpy(s->out + sizeof(FifoLzBlockHdr), s->raw, s->used);
+        size = s->used;
+    }
+    hdr->size = (uint32_t)size;
+
+    iov.iov_base = s->out;
+    iov.iov_len = sizeof(FifoLzBlockHdr) + size;
+    /* the block buffer is reused, so the next sink writes it before returning */
+    s->next->write(s->next, fifo, &iov, 1, 0, false);
+
+    s->stats.raw_bytes += s->used;
+    s->stats.block_bytes += iov.iov_len;
+    s->stats.blocks++;
+    s->used = 0;
+}
+
+static void lz_sink_write(FifoSink *sink, fifo_t *fifo, const struct iovec *iov, int iovcnt, size_t release,
+        bool in_ring) {
+    FifoLzSink *s = (FifoLzSink *)sink;
+    size_t done, copy;
+    int i;
+
+    (void)in_ring;
+    for (i = 0; i < iovcnt; i++) {
+        for (done = 0; done < iov[i].iov_len; done += copy) {
+            copy = s->block_size - s->used;
+            copy = copy < iov[i].iov_len - done ? copy : iov[i].iov_len - done;
+            if (!s->used) {
+                s->block_time = fifo_platform_get_time();
+            }
+            memcpy(s->raw + s->used, (const char *)iov[i].iov_base + done, copy);
+            s->used += copy;
+            if (s->used == s->block_size) {
+                lz_sink_emit(s, fifo);
+            }
+        }
+    }
+    /* the data is copied out, the producers can reuse the space before the block is full */
+    if (release) {
+        fifo_release_h(fifo, release);
+    }
+}
+
+static uint32_t lz_sink_flush(FifoSink *sink, fifo_t *fifo, bool idle) {
+    FifoLzSink *s = (FifoLzSink *)sink;
+    uint64_t age;
+    uint32_t hold_ms = 0, next_hold_ms = 0;
+
+    /* a partial block is kept for a while, so the idle wakeups do not write tiny blocks */
+    if (idle && s->used && s->hold_ns) {
+        age = fifo_platform_get_time() - s->block_time;
+        if (age < s->hold_ns) {
+            hold_ms = (uint32_t)((s->hold_ns - age + 999999) / 1000000);
+        }
+    }
+    if (!hold_ms) {
+        lz_sink_emit(s, fifo);
+    }
+    if (s->next->flush) {
+        next_hold_ms = s->next->flush(s->next, fifo, idle);
+    }
+
+    return !hold_ms || (next_hold_ms && next_hold_ms < hold_ms) ? next_hold_ms : hold_ms;
+}
+
+/**
+ * create a compression sink, pass it to FifoCfg.sink. it is destroyed after the instance, before the next sink.
+ *
+ * @param cfg configuration
+ *
+ * @return sink, NULL when no next sink or no memory
+ */
+FifoSink *fifo_lz_sink_create(const FifoLzSinkCfg *cfg) {
+    FifoLzSink *s;
+
+    if (!cfg->next || cfg->block_size > FIFO_LZ_BLOCK_SIZE_MAX || !(s = calloc(1, sizeof(FifoLzSink)))) {
+        return NULL;
+    }
+    s->sink.write = lz_sink_write;
+    s->sink.flush = lz_sink_flush;
+    s->next = cfg->next;
+    s->block_size = cfg->block_size ? cfg->block_size : FIFO_LZ_BLOCK_SIZE;
+    s->hold_ns = (uint64_t)cfg->hold_ms * 1000000;
+    s->raw = malloc(s->block_size);
+    s->out = malloc(sizeof(FifoLzBlockHdr) + FIFO_LZ_BOUND(s->block_size));
+    s->work = malloc(FIFO_LZ_WORK_SIZE);
+    if (!s->raw || !s->out || !s->work) {
+        fifo_lz_sink_destroy(&s->sink);
+        return NULL;
+    }
+
+    return &s->sink;
+}
+
+/**
+ * destroy a compression sink, the instance using it is destroyed before
+ *
+ * @param sink sink
+ */
+void fifo_lz_sink_destroy(FifoSink *sink) {
+    FifoLzSink *s = (FifoLzSink *)sink;
+
+    if (!s) {
+        return;
+    }
+    free(s->raw);
+    free(s->out);
+    free(s->work);
+    free(s);
+}
+
+/**
+ * compression statistics of a compression sink, only the output thread updates them
+ *
+ * @param sink sink
+ * @param stats statistics
+ */
+void fifo_lz_sink_get_stats(FifoSink *sink, FifoLzSinkStats *stats) {
+    *stats = ((FifoLzSink *)sink)->stats;
+}
@@ -0,0 +1,310 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Statistics and latency histograms of the instances.
+ * Created on: 2026-10-17
+ */
+
+#include "fifo_def.h"
+
+#ifdef FIFO_USING_STATS
+#include <string.h>
+#include <stdlib.h>
+
+/* counter shards of an instance, threads beyond it share the shards */
+#ifndef FIFO_STATS_SHARDS
+#define FIFO_STATS_SHARDS                           16
+#endif
+
+/* counters written by the threads of one shard */
+typedef struct {
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_uint_fast64_t pushes;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t drops;
+    atomic_uint_fast64_t truncations;
+    atomic_uint_fast64_t overwrites;
+    atomic_uint_fast64_t spills;
+    atomic_size_t high_water;
+    atomic_uint_fast64_t lock_wait_ns;
+    atomic_uint_fast64_t commit_wait_ns;
+    atomic_uint_fast64_t push_ns[FIFO_HIST_BUCKETS];
+} FifoStatsShard;
+
+/* counters written by the output thread only */
+typedef struct {
+    _Alignas(FIFO_CACHE_LINE_SIZE) atomic_uint_fast64_t wakeups;
+    atomic_uint_fast64_t latency_ns[FIFO_HIST_BUCKETS];
+} FifoStatsCons;
+
+struct fifo_stats {
+    FifoStatsShard shards[FIFO_STATS_SHARDS];
+    FifoStatsCons cons;
+};
+
+/* shard id of this thread, 0: not assigned */
+static FIFO_THREAD_LOCAL unsigned s_shard_id;
+static atomic_uint s_shard_next = 1;
+
+/**
+ * statistics initialize
+ *
+ * @param fifo instance
+ *
+ * @return result
+ */
+FifoErrCode fifo_stats_init(fifo_t *fifo) {
+    fifo->stats = aligned_alloc(FIFO_CACHE_LINE_SIZE, sizeof(struct fifo_stats));
+    if (!fifo->stats) {
+        return FIFO_ERR_NO_MEM;
+    }
+    /* zero is a valid initial state of the atomic counters */
+    memset(fifo->stats, 0, sizeof(struct fifo_stats));
+
+    return FIFO_NO_ERR;
+}
+
+/**
+ * statistics deinitialize
+ *
+ * @param fifo instance
+ */
+void fifo_stats_deinit(fifo_t *fifo) {
+    free(fifo->stats);
+    fifo->stats = NULL;
+}
+
+/**
+ * current time for the durations
+ *
+ * @return time in nanoseconds
+ */
+uint64_t fifo_stats_now(void) {
+    return fifo_platform_get_time();
+}
+
+/**
+ * shard of this thread, every thread keeps its shard id for all instances
+ */
+static FifoStatsShard *fifo_stats_shard(fifo_t *fifo) {
+    if (!s_shard_id) {
+        s_shard_id = atomic_fetch_add_explicit(&s_shard_next, 1, memory_order_relaxed);
+    }
+
+    return &fifo->stats->shards[s_shard_id % FIFO_STATS_SHARDS];
+}
+
+/**
+ * histogram bucket of the value
+ *
+ * @param value value
+ *
+ * @return bucket index
+ */
+static size_t fifo_hist_index(uint64_t value) {
+    unsigned msb;
+
+    /* the first power of 2 range is linear */
+    if (value < (1 << FIFO_HIST_SUB_BITS)) {
+        return (size_t)value;
+    }
+    msb = 63 - __builtin_clzll(value);
+    if (msb >= FIFO_HIST_MAX_BITS) {
+        return FIFO_HIST_BUCKETS - 1;
+    }
+
+    return ((size_t)(msb - FIFO_HIST_SUB_BITS + 1) << FIFO_HIST_SUB_BITS)
+            + ((value >> (msb - FIFO_HIST_SUB_BITS)) & ((1 << FIFO_HIST_SUB_BITS) - 1));
+}
+
+/**
+ * highest value counted in the histogram bucket
+ *
+ * @param index bucket index
+ *
+ * @return value
+ */
+static uint64_t fifo_hist_value(size_t index) {
+    size_t range = index >> FIFO_HIST_SUB_BITS, sub = index & ((1 << FIFO_HIST_SUB_BITS) - 1);
+
+    if (!range) {
+        return index;
+    }
+
+    return (((uint64_t)((1 << FIFO_HIST_SUB_BITS) + sub + 1)) << (range - 1)) - 1;
+}
+
+void fifo_stats_push(fifo_t *fifo, FifoErrCode result, size_t size, uint64_t start) {
+    FifoStatsShard *shard = fifo_stats_shard(fifo);
+
+    switch (result) {
+    case FIFO_NO_ERR:
+        break;
+    case FIFO_ERR_TRUNCATED:
+        atomic_fetch_add_explicit(&shard->truncations, 1, memory_order_relaxed);
+        break;
+    case FIFO_ERR_OVERWRITTEN:
+        atomic_fetch_add_explicit(&shard->overwrites, 1, memory_order_relaxed);
+        break;
+    case FIFO_ERR_SPILLED:
+        atomic_fetch_add_explicit(&shard->spills, 1, memory_order_relaxed);
+        break;
+    default:
+        atomic_fetch_add_explicit(&shard->drops, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&shard->pushes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->bytes, size, memory_order_relaxed);
+    if (start) {
+        atomic_fetch_add_explicit(&shard->push_ns[fifo_hist_index(fifo_platform_get_time() - start)], 1,
+                memory_order_relaxed);
+    }
+}
+
+void fifo_stats_used(fifo_t *fifo, size_t used) {
+    FifoStatsShard *shard = fifo_stats_shard(fifo);
+
+    /* the shard is written by few threads, a lost race only delays the new mark to the next push */
+    if (used > atomic_load_explicit(&shard->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&shard->high_water, used, memory_order_relaxed);
+    }
+}
+
+void fifo_stats_lock_wait(fifo_t *fifo, uint64_t start) {
+    atomic_fetch_add_explicit(&fifo_stats_shard(fifo)->lock_wait_ns, fifo_platform_get_time() - start,
+            memory_order_relaxed);
+}
+
+void fifo_stats_commit_wait(fifo_t *fifo, uint64_t start) {
+    atomic_fetch_add_explicit(&fifo_stats_shard(fifo)->commit_wait_ns, fifo_platform_get_time() - start,
+            memory_order_relaxed);
+}
+
+/**
+ * output thread counters have a single writer, they are updated without read-modify-write
+ */
+static void fifo_stats_cons_inc(atomic_uint_fast64_t *counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void fifo_stats_wakeup(fifo_t *fifo) {
+    fifo_stats_cons_inc(&fifo->stats->cons.wakeups);
+}
+
+void fifo_stats_latency(fifo_t *fifo, const FifoRecord *records, size_t count) {
+    uint64_t now;
+    size_t i;
+
+    if (!(fifo->flags & FIFO_FLAG_TIMESTAMP) || !count) {
+        return;
+    }
+    now = fifo_platform_get_time();
+    for (i = 0; i < count; i++) {
+        fifo_stats_cons_inc(&fifo->stats->cons.latency_ns[fifo_hist_index(
+                now > records[i].timestamp ? now - records[i].timestamp : 0)]);
+    }
+}
+
+/**
+ * sum a histogram
+ */
+static void fifo_hist_add(FifoHist *hist, const atomic_uint_fast64_t *buckets) {
+    uint64_t count;
+    size_t i;
+
+    for (i = 0; i < FIFO_HIST_BUCKETS; i++) {
+        count = atomic_load_explicit(&buckets[i], memory_order_relaxed);
+        hist->buckets[i] += count;
+        hist->count += count;
+    }
+}
+
+/**
+ * get the statistics of the instance, the shards are summed without stopping the writers
+ *
+ * @param fifo instance
+ * @param stats statistics
+ *
+ * @return result
+ */
+FifoErrCode fifo_get_stats_h(fifo_t *fifo, FifoStats *stats) {
+    const FifoStatsShard *shard;
+    size_t i, high_water;
+
+    if (!fifo) {
+        return FIFO_ERR_DISABLED;
+    }
+
+    memset(stats, 0, sizeof(FifoStats));
+    for (i = 0; i < FIFO_STATS_SHARDS; i++) {
+        shard = &fifo->stats->shards[i];
+        stats->pushes += atomic_load_explicit(&shard->pushes, memory_order_relaxed);
+        stats->bytes += atomic_load_explicit(&shard->bytes, memory_order_relaxed);
+        stats->drops += atomic_load_explicit(&shard->drops, memory_order_relaxed);
+        stats->truncations += atomic_load_explicit(&shard->truncations, memory_order_relaxed);
+        stats->overwrites += atomic_load_explicit(&shard->overwrites, memory_order_relaxed);
+        stats->spills += atomic_load_explicit(&shard->spills, memory_order_relaxed);
+        stats->lock_wait_ns += atomic_load_explicit(&shard->lock_wait_ns, memory_order_relaxed);
+        stats->commit_wait_ns += atomic_load_explicit(&shard->commit_wait_ns, memory_order_relaxed);
+        high_water = atomic_load_explicit(&shard->high_water, memory_order_relaxed);
+        if (high_water > stats->high_water) {
+            stats->high_water = high_water;
+        }
+        fifo_hist_add(&stats->push_ns, shard->push_ns);
+    }
+    stats->wakeups = atomic_load_explicit(&fifo->stats->cons.wakeups, memory_order_relaxed);
+    fifo_hist_add(&stats->latency_ns, fifo->stats->cons.latency_ns);
+
+    return FIFO_NO_ERR;
+}
+
+/**
+ * value at the percentile of the histogram
+ *
+ * @param hist histogram
+ * @param percentile percentile, 0 to 100
+ *
+ * @return the highest value of the bucket which reaches the percentile, 0 when the histogram is empty
+ */
+uint64_t fifo_hist_percentile(const FifoHist *hist, double percentile) {
+    uint64_t target, count = 0;
+    size_t i;
+
+    if (!hist->count) {
+        return 0;
+    }
+    target = (uint64_t)(hist->count * percentile / 100.0);
+    if (target < 1) {
+        target = 1;
+    }
+    for (i = 0; i < FIFO_HIST_BUCKETS; i++) {
+        count += hist->buckets[i];
+        if (count >= target) {
+            break;
+        }
+    }
+
+    return fifo_hist_value(i < FIFO_HIST_BUCKETS ? i : FIFO_HIST_BUCKETS - 1);
+}
+
+#endif /* FIFO_USING_STATS */
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: typed channel test, push and drain, the full channel and the destruction of the elements.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+static std::size_t errors;
+
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            std::printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);            \
+            errors++;                                                           \
+        }                                                                       \
+    } while (0)
+
+/* element which counts the live objects, it is not trivially copyable */
+struct Tracked {
+    static int live;
+    int value;
+
+    explicit Tracked(int v) : value(v) {
+        live++;
+    }
+    Tracked(const Tracked &other) : value(other.value) {
+        live++;
+    }
+    ~Tracked() {
+        live--;
+    }
+};
+
+int Tracked::live = 0;
+
+/**
+ * push until the channel is full, drain it in push order, then push again over the released space
+ */
+template <std::size_t Capacity>
+static void test_trivial(void) {
+    fifo::channel<std::uint64_t, Capacity> chan;
+    std::uint64_t next = 0, expect = 0;
+    std::size_t round, pushed;
+
+    TEST_CHECK(chan);
+    for (round = 0; round < 4; round++) {
+        for (pushed = 0; chan.try_push(next); pushed++) {
+            next++;
+        }
+        TEST_CHECK(pushed == Capacity);
+        TEST_CHECK(chan.size() == Capacity);
+        TEST_CHECK(chan.drain([&](std::uint64_t &value) { TEST_CHECK(value == expect++); }) == Capacity);
+        TEST_CHECK(chan.size() == 0);
+    }
+    TEST_CHECK(expect == next);
+}
+
+/**
+ * a move only element, the ones left in the channel are destroyed with it
+ */
+static void test_move_only(void) {
+    std::size_t pushed = 0, drained = 0;
+
+    {
+        fifo::channel<std::unique_ptr<std::string>, 8> chan;
+
+        while (chan.try_push(std::make_unique<std::string>(std::to_string(pushed)))) {
+            pushed++;
+        }
+        TEST_CHECK(pushed == 8);
+        /* a failed push does not move from the value */
+        auto rest = std::make_unique<std::string>("rest");
+        TEST_CHECK(!chan.try_push(std::move(rest)) && rest && *rest == "rest");
+        chan.drain([&](std::unique_ptr<std::string> &value) {
+            TEST_CHECK(value && *value == std::to_string(drained));
+            drained++;
+        }, 3);
+        TEST_CHECK(drained == 3 && chan.size() == 5);
+    }
+}
+
+/**
+ * every element is destroyed once, by the drain or by the channel destructor
+ */
+static void test_destroy(void) {
+    int sum = 0;
+
+    {
+        fifo::channel<Tracked, 16> chan;
+        int i;
+
+        for (i = 0; chan.emplace(i); i++);
+        TEST_CHECK(i == 16);
+        TEST_CHECK(Tracked::live == 16);
+        chan.drain([&](Tracked &value) { sum += value.value; }, 10);
+        TEST_CHECK(sum == 45);
+        TEST_CHECK(Tracked::live == 6);
+        /* the slots of the drained elements are free again */
+        TEST_CHECK(chan.emplace(100) && Tracked::live == 7);
+    }
+    TEST_CHECK(Tracked::live == 0);
+}
+
+int main(void) {
+    /* a power of 2 record and one that needs the padding checks */
+    test_trivial<16>();
+    test_trivial<100>();
+    test_move_only();
+    test_destroy();
+    std::printf("channel,%zu,%s\n", errors, errors ? "FAIL" : "ok");
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: file backed ring buffer recovery test. A new process image pushes deferred and plain records
+ *           and exits without output, the parent recovers the file and checks that every record is output
+ *           formatted, in order. The writer is executed again, so its addresses are not those of the parent.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define TEST_RECORDS                3
+
+static const char *expect[TEST_RECORDS] = {
+    "deferred 1 two",
+    "plain 42",
+    "deferred 0x2a 3.50",
+};
+static size_t checked, errors;
+
+static void test_pop_records(const FifoRecord *records, size_t count) {
+    size_t i, size;
+
+    for (i = 0; i < count; i++, checked++) {
+        /* the formatted log may carry its terminator */
+        size = strnlen(records[i].data, records[i].size);
+        if (checked >= TEST_RECORDS || size != strlen(expect[checked])
+                || memcmp(records[i].data, expect[checked], size)) {
+            printf("  record %zu: '%.*s'\n", checked, (int)records[i].size, records[i].data);
+            errors++;
+        }
+    }
+}
+
+static void test_cfg(FifoCfg *cfg, const char *path) {
+    memset(cfg, 0, sizeof(FifoCfg));
+    cfg->capacity = 4096;
+    /* the output is only the poll of the recovering process */
+    cfg->flags = FIFO_FLAG_FRAMED | FIFO_FLAG_NO_THREAD;
+    cfg->ring_path = path;
+    cfg->callbacks.fp_fifo_pop_records = test_pop_records;
+}
+
+/**
+ * writer process, it exits like a crash, the records stay in the file
+ */
+static void test_writer(const char *path) {
+    FifoCfg cfg;
+    fifo_t *fifo;
+
+    test_cfg(&cfg, path);
+    fifo = fifo_create(&cfg);
+    if (!fifo || fifo_dpush_h(fifo, "deferred %d %s", 1, "two") != FIFO_NO_ERR
+            || fifo_push_h(fifo, "plain %d", 42) != FIFO_NO_ERR
+            || fifo_dpush_h(fifo, "deferred %#x %.2f", 42, 3.5) != FIFO_NO_ERR) {
+        _exit(EXIT_FAILURE);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[]) {
+    char path[] = "/tmp/fifo_test_file_XXXXXX";
+    FifoCfg cfg;
+    fifo_t *fifo;
+    pid_t pid;
+    int fd, status;
+
+    if (argc == 3 && !strcmp(argv[1], "-w")) {
+        test_writer(argv[2]);
+    }
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    /* the ring buffer is made by the writer */
+    unlink(path);
+
+    pid = fork();
+    if (pid == 0) {
+        execl("/proc/self/exe", argv[0], "-w", path, (char *)NULL);
+        _exit(EXIT_FAILURE);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        printf("recover: writer failed\n");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    test_cfg(&cfg, path);
+    fifo = fifo_create(&cfg);
+    if (!fifo) {
+        printf("recover: create failed\n");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+    fifo_poll_h(fifo, SIZE_MAX);
+    fifo_destroy(fifo);
+    unlink(path);
+
+    if (checked != TEST_RECORDS) {
+        printf("  %zu of %d records\n", checked, TEST_RECORDS);
+        errors++;
+    }
+    printf("recover,%zu,%zu,%s\n", checked, errors, errors ? "FAIL" : "ok");
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: statistics test, it is built with FIFO_USING_STATS. Known pushes, drops and truncations go to
+ *           instances without output thread, then every counter of fifo_get_stats_h is checked.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FIFO_USING_STATS
+#error "build it with -DFIFO_USING_STATS"
+#endif
+
+#define TEST_CAPACITY               4096
+
+static size_t errors;
+static size_t popped;
+
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);                 \
+            errors++;                                                           \
+        }                                                                       \
+    } while (0)
+
+static void test_pop(const char *log, size_t size) {
+    (void)log;
+    popped += size;
+}
+
+static void test_pop_records(const FifoRecord *records, size_t count) {
+    (void)records;
+    popped += count;
+}
+
+static fifo_t *test_create(uint32_t flags, FifoOverflow overflow) {
+    FifoCfg cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.capacity = TEST_CAPACITY;
+    /* nothing is output until the test polls */
+    cfg.flags = flags | FIFO_FLAG_NO_THREAD;
+    cfg.overflow = overflow;
+    if (flags & FIFO_FLAG_FRAMED) {
+        cfg.callbacks.fp_fifo_pop_records = test_pop_records;
+    } else {
+        cfg.callbacks.fp_fifo_pop = test_pop;
+    }
+
+    return fifo_create(&cfg);
+}
+
+/**
+ * stream pushes into a dropping ring buffer, it fills up, then a push is cut and the next ones are dropped
+ */
+static void test_drop(void) {
+    static char data[TEST_CAPACITY], big[TEST_CAPACITY * 3];
+    fifo_t *fifo = test_create(0, FIFO_OVERFLOW_DROP);
+    FifoStats stats;
+    int i;
+
+    TEST_CHECK(fifo);
+    if (!fifo) {
+        return;
+    }
+    memset(big, 'x', sizeof(big) - 1);
+    for (i = 0; i < 10; i++) {
+        TEST_CHECK(fifo_write_h(fifo, data, 100) == FIFO_NO_ERR);
+    }
+    TEST_CHECK(fifo_write_h(fifo, data, 4000) == FIFO_ERR_TRUNCATED);
+    TEST_CHECK(fifo_write_h(fifo, data, 10) == FIFO_ERR_DROPPED);
+    TEST_CHECK(fifo_push_h(fifo, "%s", big) == FIFO_ERR_DROPPED);
+
+    TEST_CHECK(fifo_get_stats_h(fifo, &stats) == FIFO_NO_ERR);
+    /* the cut push is stored, only its head is counted */
+    TEST_CHECK(stats.pushes == 11);
+    TEST_CHECK(stats.bytes == TEST_CAPACITY);
+    TEST_CHECK(stats.drops == 2);
+    TEST_CHECK(stats.truncations == 1);
+    TEST_CHECK(stats.overwrites == 0 && stats.spills == 0);
+    TEST_CHECK(stats.high_water == TEST_CAPACITY);
+    TEST_CHECK(stats.push_ns.count == stats.pushes);
+    /* no output thread parks, and no record carries a timestamp */
+    TEST_CHECK(stats.wakeups == 0);
+    TEST_CHECK(stats.latency_ns.count == 0);
+    TEST_CHECK(fifo_get_dropped_h(fifo) == 3);
+
+    popped = 0;
+    TEST_CHECK(fifo_poll_h(fifo, 0) == TEST_CAPACITY && popped == TEST_CAPACITY);
+    TEST_CHECK(fifo_write_h(fifo, data, 100) == FIFO_NO_ERR);
+    TEST_CHECK(fifo_get_stats_h(fifo, &stats) == FIFO_NO_ERR);
+    TEST_CHECK(stats.pushes == 12 && stats.bytes == TEST_CAPACITY + 100);
+    /* the mark stays at the highest use */
+    TEST_CHECK(stats.high_water == TEST_CAPACITY);
+    fifo_destroy(fifo);
+}
+
+/**
+ * a push over the oldest data is stored and counted as an overwrite
+ */
+static void test_overwrite(void) {
+    static char data[3000];
+    fifo_t *fifo = test_create(0, FIFO_OVERFLOW_OVERWRITE);
+    FifoStats stats;
+
+    TEST_CHECK(fifo);
+    if (!fifo) {
+        return;
+    }
+    TEST_CHECK(fifo_write_h(fifo, data, sizeof(data)) == FIFO_NO_ERR);
+    TEST_CHECK(fifo_write_h(fifo, data, sizeof(data)) == FIFO_ERR_OVERWRITTEN);
+    TEST_CHECK(fifo_get_stats_h(fifo, &stats) == FIFO_NO_ERR);
+    TEST_CHECK(stats.pushes == 2 && stats.bytes == 2 * sizeof(data));
+    TEST_CHECK(stats.overwrites == 1 && stats.drops == 0 && stats.truncations == 0);
+    fifo_destroy(fifo);
+}
+
+/**
+ * every timestamped record output counts a latency
+ */
+static void test_latency(void) {
+    fifo_t *fifo = test_create(FIFO_FLAG_FRAMED | FIFO_FLAG_TIMESTAMP, FIFO_OVERFLOW_DROP);
+    FifoStats stats;
+    int i;
+
+    TEST_CHECK(fifo);
+    if (!fifo) {
+        return;
+    }
+    for (i = 0; i < 5; i++) {
+        TEST_CHECK(fifo_push_h(fifo, "record %d", i) == FIFO_NO_ERR);
+    }
+    popped = 0;
+    fifo_poll_h(fifo, 0);
+    TEST_CHECK(popped == 5);
+    TEST_CHECK(fifo_get_stats_h(fifo, &stats) == FIFO_NO_ERR);
+    TEST_CHECK(stats.pushes == 5 && stats.push_ns.count == 5);
+    TEST_CHECK(stats.latency_ns.count == 5);
+    TEST_CHECK(fifo_hist_percentile(&stats.latency_ns, 50) <= fifo_hist_percentile(&stats.latency_ns, 100));
+    fifo_destroy(fifo);
+}
+
+/**
+ * the percentile is the highest value of the bucket which reaches it
+ */
+static void test_percentile(void) {
+    static FifoHist hist;
+
+    TEST_CHECK(fifo_hist_percentile(&hist, 50) == 0);
+    /* the first buckets count one value each */
+    hist.buckets[3] = 90;
+    hist.buckets[FIFO_HIST_BUCKETS - 1] = 10;
+    hist.count = 100;
+    TEST_CHECK(fifo_hist_percentile(&hist, 50) == 3);
+    TEST_CHECK(fifo_hist_percentile(&hist, 90) == 3);
+    TEST_CHECK(fifo_hist_percentile(&hist, 99) >= (1ULL << FIFO_HIST_MAX_BITS) - 1);
+    TEST_CHECK(fifo_get_stats_h(NULL, NULL) == FIFO_ERR_DISABLED);
+}
+
+int main(void) {
+    test_drop();
+    test_overwrite();
+    test_latency();
+    test_percentile();
+    printf("stats,%zu,%s\n", errors, errors ? "FAIL" : "ok");
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
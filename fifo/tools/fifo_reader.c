@@ -0,0 +1,240 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Reader of the file backed ring buffer. It outputs the unread data after a crash,
+ *           or tails the file while the writer runs. The writer never waits for it.
+ *           A shared memory ring buffer is read at /dev/shm/<name>.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo.h>
+#include <fifo_file.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* idle time of the follow mode */
+#define READER_POLL_US              10000
+
+typedef struct {
+    FifoFileHdr *hdr;
+    const char *data;
+    size_t map_size;
+    /* record header size with the optional stamps, 0: stream mode */
+    size_t rec_hdr_size;
+    /* print the sequence number and the timestamp of every record */
+    bool verbose;
+    /* copy of the data being output, the writer may overwrite the mapping meanwhile */
+    char *copy;
+} Reader;
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-f] [-c] [-v] <ring file>\n"
+            "  -f  follow the new data, the writer keeps running\n"
+            "  -c  consume the output data, only when the writer is not running\n"
+            "  -v  print the sequence number and timestamp of framed records\n", name);
+}
+
+/**
+ * map the ring file and check its header
+ *
+ * @return 0: success
+ */
+static int reader_open(Reader *reader, const char *path, bool writable) {
+    FifoFileHdr hdr;
+    struct stat st;
+    int fd;
+
+    fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(hdr) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+            || hdr.magic != FIFO_FILE_MAGIC || hdr.version != FIFO_FILE_VERSION
+            || (hdr.capacity & (hdr.capacity - 1)) || (uint64_t)st.st_size < hdr.data_offset + hdr.capacity) {
+        fprintf(stderr, "%s: not a version %d fifo ring file\n", path, FIFO_FILE_VERSION);
+        close(fd);
+        return -1;
+    }
+
+    reader->map_size = hdr.data_offset + hdr.capacity;
+    reader->hdr = mmap(NULL, reader->map_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    close(fd);
+    if (reader->hdr == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    reader->data = (const char *)reader->hdr + hdr.data_offset;
+    reader->rec_hdr_size = 0;
+    if (hdr.flags & FIFO_FLAG_FRAMED) {
+        reader->rec_hdr_size = sizeof(FifoRecHdr);
+        if (hdr.flags & FIFO_FLAG_SEQ) {
+            reader->rec_hdr_size += sizeof(uint64_t);
+        }
+        if (hdr.flags & FIFO_FLAG_TIMESTAMP) {
+            reader->rec_hdr_size += sizeof(uint64_t);
+        }
+    }
+    reader->copy = malloc(hdr.capacity);
+    if (!reader->copy) {
+        munmap(reader->hdr, reader->map_size);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * copy [begin, end) out of the storage
+ *
+ * @return copy is valid, false: the writer overwrote a part of it
+ */
+static bool reader_copy(Reader *reader, uint64_t begin, uint64_t end) {
+    uint64_t capacity = reader->hdr->capacity;
+    size_t offset = begin & (capacity - 1), size = end - begin, first;
+
+    first = capacity - offset < size ? capacity - offset : size;
+    memcpy(reader->copy, reader->data + offset, first);
+    memcpy(reader->copy + first, reader->data, size - first);
+    /* the copy is read before the reservations which may overwrite it */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&reader->hdr->prod_head, __ATOMIC_RELAXED) - begin <= capacity;
+}
+
+/**
+ * output the copied records or stream data
+ */
+static void reader_output(Reader *reader, size_t size) {
+    const FifoRecHdr *hdr;
+    const char *stamp;
+    uint64_t seq = 0, timestamp = 0;
+    size_t index = 0, total;
+
+    if (!reader->rec_hdr_size) {
+        fwrite(reader->copy, 1, size, stdout);
+        return;
+    }
+
+    while (index + sizeof(FifoRecHdr) <= size) {
+        hdr = (const FifoRecHdr *)(reader->copy + index);
+        total = hdr->type == FIFO_REC_PAD ? sizeof(FifoRecHdr) + hdr->size
+                : FIFO_REC_ALIGN(reader->rec_hdr_size + hdr->size);
+        if (total > size - index) {
+            fprintf(stderr, "fifo_reader: broken record at %zu\n", index);
+            return;
+        }
+        index += total;
+        if (hdr->type == FIFO_REC_PAD) {
+            continue;
+        }
+        if (reader->verbose) {
+            stamp = (const char *)hdr + sizeof(FifoRecHdr);
+            if (reader->hdr->flags & FIFO_FLAG_SEQ) {
+                memcpy(&seq, stamp, sizeof(seq));
+                stamp += sizeof(seq);
+            }
+            if (reader->hdr->flags & FIFO_FLAG_TIMESTAMP) {
+                memcpy(&timestamp, stamp, sizeof(timestamp));
+            }
+            printf("[%llu %llu.%09llu] ", (unsigned long long)seq, (unsigned long long)(timestamp / 1000000000),
+                    (unsigned long long)(timestamp % 1000000000));
+        }
+        if (hdr->type == FIFO_REC_DEFERRED) {
+            /* the format string is in the writer memory */
+            printf("<deferred record, %u bytes>\n", (unsigned)hdr->size);
+        } else {
+            fwrite((const char *)hdr + reader->rec_hdr_size, 1, hdr->size, stdout);
+            if (!hdr->size || ((const char *)hdr + reader->rec_hdr_size)[hdr->size - 1] != '\n') {
+                putchar('\n');
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Reader reader = { 0 };
+    bool follow = false, consume = false;
+    uint64_t pos, end;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "fcv")) != -1) {
+        switch (opt) {
+        case 'f':
+            follow = true;
+            break;
+        case 'c':
+            consume = true;
+            break;
+        case 'v':
+            reader.verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 || (follow && consume)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (reader_open(&reader, argv[optind], consume) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    /* a private cursor, the writer output thread keeps its own read index */
+    pos = __atomic_load_n(&reader.hdr->cons_tail, __ATOMIC_ACQUIRE);
+    do {
+        end = __atomic_load_n(&reader.hdr->prod_tail, __ATOMIC_ACQUIRE);
+        if (end == pos) {
+            fflush(stdout);
+            usleep(READER_POLL_US);
+            continue;
+        }
+        if (end - pos > reader.hdr->capacity || !reader_copy(&reader, pos, end)) {
+            /* the writer wrapped over the cursor, continue at the latest record boundary */
+            fprintf(stderr, "fifo_reader: overrun, %llu bytes lost\n", (unsigned long long)(end - pos));
+            pos = end;
+            continue;
+        }
+        reader_output(&reader, end - pos);
+        pos = end;
+    } while (follow);
+
+    if (consume) {
+        __atomic_store_n(&reader.hdr->cons_tail, pos, __ATOMIC_RELEASE);
+        msync(reader.hdr, reader.map_size, MS_SYNC);
+    }
+    fflush(stdout);
+    munmap(reader.hdr, reader.map_size);
+    free(reader.copy);
+
+    return EXIT_SUCCESS;
+}
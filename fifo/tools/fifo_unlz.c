@@ -0,0 +1,110 @@
+/*
+ * This file is part of the fifo Library.
+ *
+ * Copyright (c) 2015-2018, Armink, <armink.ztl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * 'Software'), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS', WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Function: Decompressor of the compression sink output. It reads the concatenated blocks from a file
+ *           or the standard input and writes the raw stream to the standard output.
+ * Created on: 2026-10-17
+ */
+
+#include <fifo_lz.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [file]\n"
+            "  decompress the blocks of a compression sink output, the standard input without file\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    FILE *in = stdin;
+    FifoLzBlockHdr hdr;
+    char *payload = NULL, *raw = NULL;
+    size_t payload_size = 0, raw_size = 0, size;
+    unsigned long long offset = 0;
+    int result = EXIT_FAILURE;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc == 2 && !(in = fopen(argv[1], "rb"))) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    while ((size = fread(&hdr, 1, sizeof(hdr), in)) == sizeof(hdr)) {
+        if (hdr.magic != FIFO_LZ_MAGIC || hdr.raw_size > FIFO_LZ_BLOCK_SIZE_MAX
+                || hdr.size > FIFO_LZ_BOUND((size_t)FIFO_LZ_BLOCK_SIZE_MAX)) {
+            fprintf(stderr, "fifo_unlz: bad block header at %llu\n", offset);
+            goto __exit;
+        }
+        /* the buffers grow to the largest block */
+        if (hdr.size > payload_size) {
+            free(payload);
+            payload_size = hdr.size;
+            payload = malloc(payload_size);
+        }
+        if (hdr.raw_size > raw_size) {
+            free(raw);
+            raw_size = hdr.raw_size;
+            raw = malloc(raw_size);
+        }
+        if ((hdr.size && !payload) || (hdr.raw_size && !raw)) {
+            fprintf(stderr, "fifo_unlz: no memory\n");
+            goto __exit;
+        }
+        if (fread(payload, 1, hdr.size, in) != hdr.size) {
+            fprintf(stderr, "fifo_unlz: truncated block at %llu\n", offset);
+            goto __exit;
+        }
+        if (hdr.flags & FIFO_LZ_BLOCK_RAW) {
+            size = hdr.size == hdr.raw_size ? hdr.size : 0;
+            fwrite(payload, 1, size, stdout);
+        } else {
+            size = fifo_lz_decompress(payload, hdr.size, raw, hdr.raw_size);
+            fwrite(raw, 1, size, stdout);
+        }
+        if (size != hdr.raw_size) {
+            fprintf(stderr, "fifo_unlz: broken block at %llu\n", offset);
+            goto __exit;
+        }
+        offset += sizeof(hdr) + hdr.size;
+    }
+    if (size) {
+        fprintf(stderr, "fifo_unlz: truncated block header at %llu\n", offset);
+        goto __exit;
+    }
+    result = EXIT_SUCCESS;
+
+__exit:
+    fflush(stdout);
+    free(payload);
+    free(raw);
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    return result;
+}